@@ -10,13 +10,200 @@
 #pragma once
 #include "bitbot_kernel/bus/bus_manager.hpp"
 #include "device/Encos_device.hpp"
+#include "device/Encos_mailbox.hpp"
 #include "bus/Encos_bus_msg.h"
+#include "bus/Encos_joint_table.h"
+#include "bus/Encos_snapshot.h"
+#include "bus/Encos_rt_logger.h"
 #include "atomic"
 #include "vector"
 #include "map"
+#include "thread"
+#include "memory"
+#include "span"
+#include "readerwriterqueue.h"
 
 namespace bitbot
 {
+    class EncosJoint;
+    class YesenseIMU;
+
+    /**
+     * @brief Encos电机应答类型1(位置，速度，电流，温度)的批量解码缓冲区。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     * @details 总线在一个周期内先收集所有电机的应答帧，再以结构体数组的方式统一解码，解码循环无分支，便于编译器向量化。
+     *
+     */
+    struct EncosJointReplyBatch
+    {
+        /// @brief 本周期收集到的应答数量
+        size_t count = 0;
+        /// @brief 应答对应的电机
+        std::vector<EncosJoint*> joint;
+        /// @brief 错误码
+        std::vector<uint8_t> error_code;
+
+        /// @brief 原始定点数
+        std::vector<uint16_t> position_raw, velocity_raw, current_raw;
+        std::vector<uint8_t> motor_temp_raw, driver_temp_raw;
+
+        /// @brief 每个应答的反量化系数，已包含电机转动方向
+        std::vector<float> position_mul, position_add, velocity_mul, velocity_add, current_mul, current_add;
+
+        /// @brief 解码结果
+        std::vector<float> position, velocity, current, motor_temp, driver_temp;
+
+        /**
+         * @brief 分配缓冲区
+         *
+         * @param capacity 每个周期最多的应答数量
+         */
+        void Resize(size_t capacity);
+
+        /**
+         * @brief 解码收集到的所有应答
+         *
+         */
+        void Decode();
+    };
+
+    /**
+     * @brief Encos电机运动模式指令的批量编码缓冲区。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     * @details 总线在一个周期内先收集所有处于运动模式的电机指令，再以结构体数组的方式统一量化，最后将打包后的数据写入对应的CAN帧。
+     *
+     */
+    struct EncosJointCommandBatch
+    {
+        /// @brief 本周期收集到的指令数量
+        size_t count = 0;
+        /// @brief 指令写入的CAN帧
+        std::vector<CAN_Device_Msg*> frame;
+
+        /// @brief 指令目标值，已包含电机转动方向
+        std::vector<float> kp, kd, position, velocity, torque;
+
+        /// @brief 每条指令的量化参数
+        std::vector<float> kp_mul, kp_min, kd_mul, kd_min, position_mul, position_min, velocity_mul, velocity_min, torque_mul, torque_min;
+
+        /// @brief 量化结果
+        std::vector<uint32_t> kp_int, kd_int, position_int, velocity_int, torque_int;
+
+        /**
+         * @brief 分配缓冲区
+         *
+         * @param capacity 每个周期最多的指令数量
+         */
+        void Resize(size_t capacity);
+
+        /**
+         * @brief 量化收集到的所有指令并写入对应的CAN帧
+         *
+         */
+        void Encode();
+    };
+
+    /**
+     * @brief CAN设备路由区间，描述一组设备在连续设备数组中的位置。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct CAN_RouteSpan
+    {
+        /// @brief 起始位置
+        uint16_t offset = 0;
+        /// @brief 设备数量
+        uint16_t count = 0;
+    };
+
+    /**
+     * @brief CAN时分复用调度表项，设备在divider个周期中的第phase个周期占用所在的转接板通道。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct CAN_SlotEntry
+    {
+        /// @brief CAN设备
+        Encos_CANBusDevice* device = nullptr;
+        /// @brief 运动模式指令批量编码的电机，非电机设备为nullptr
+        EncosJoint* joint = nullptr;
+        /// @brief 分频系数
+        uint16_t divider = 1;
+        /// @brief 相位
+        uint16_t phase = 0;
+    };
+
+    /**
+     * @brief 实时线程每个周期上报给总线监督线程的EtherCAT通信结果。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct EtherCAT_CycleReport
+    {
+        /// @brief 周期计数
+        uint64_t cycle = 0;
+        /// @brief 本周期的工作计数器(WKC)
+        int wkc = 0;
+        /// @brief 本周期期望的工作计数器，仅包含本周期交换了数据的过程数据组
+        int expected_wkc = 0;
+    };
+
+    /**
+     * @brief EtherCAT链路统计数据，由总线在每个周期根据工作计数器(WKC)更新。
+     *
+     */
+    struct EtherCAT_LinkStatistics
+    {
+        /// @brief 最近一个周期的工作计数器
+        int last_wkc = 0;
+        /// @brief 期望的工作计数器
+        int expected_wkc = 0;
+        /// @brief 完全丢失的帧数
+        uint64_t lost_frames = 0;
+        /// @brief 工作计数器不足的帧数
+        uint64_t short_wkc = 0;
+        /// @brief 当前连续异常周期数
+        uint64_t miss_streak = 0;
+        /// @brief 历史最大连续异常周期数
+        uint64_t max_miss_streak = 0;
+    };
+
+    /**
+     * @brief 内核循环的唤醒抖动统计，即每次唤醒时刻相对截止时间的误差，由内核周期定时器按窗口统计。
+     *
+     */
+    struct EncosCycleJitter
+    {
+        /// @brief 窗口内最小唤醒误差(us)
+        double min_us = 0;
+        /// @brief 窗口内最大唤醒误差(us)
+        double max_us = 0;
+        /// @brief 窗口内唤醒误差的99分位数(us)，分辨率为1us
+        double p99_us = 0;
+        /// @brief 已完成的统计窗口数
+        uint64_t windows = 0;
+    };
+
+    /**
+     * @brief 内核循环的超时统计，由内核在每个周期更新。
+     *
+     */
+    struct EncosOverrunStatistics
+    {
+        /// @brief process_time直方图的分桶数
+        static constexpr size_t K_PROCESS_BINS = 6;
+        /// @brief 每个分桶的上限占内核周期的百分比，最后一个分桶统计超过周期的部分
+        static constexpr uint32_t K_PROCESS_BIN_PERCENT[K_PROCESS_BINS - 1] = { 25, 50, 75, 90, 100 };
+
+        /// @brief 错过截止时间的周期数
+        uint64_t overruns = 0;
+        /// @brief 错过的截止时间总数，一个周期可能错过多个截止时间
+        uint64_t missed_deadlines = 0;
+        /// @brief 当前连续超时周期数
+        uint64_t streak = 0;
+        /// @brief 历史最大连续超时周期数
+        uint64_t max_streak = 0;
+        /// @brief 历史最大process_time(us)
+        double max_process_us = 0;
+        /// @brief process_time直方图，按占内核周期的比例分桶计数
+        uint64_t process_histogram[K_PROCESS_BINS] = {};
+    };
+
     /**
      * @brief Bitbot Encos总线类，继承自BusManagerTpl，该类型仅适用于开发者使用，用户无需关心其实现细节。
      * @details Bitbot Encos总线类，继承自BusManagerTpl，用于管理Bitbot Encos总线设备。
@@ -56,6 +243,46 @@ namespace bitbot
          */
         bool InitEtherCAT(const std::string& ifname);
 
+        /**
+         * @brief 配置分布式时钟(DC)同步模式，需要在InitEtherCAT之前调用。
+         * @details 开启后所有支持DC的Encos转接板将启用SYNC0，主站以DC参考时钟为基准，通过PI控制器调整内核周期，
+         * 使主站发送时刻锁定在DC周期起点，转接板在该时刻之后sync_shift纳秒处理数据，从而获得恒定的指令下发延迟。
+         *
+         * @param enable 是否开启DC同步模式
+         * @param cycle_time 总线周期，单位为纳秒(ns)
+         * @param sync_shift SYNC0相对于DC周期起点的偏移，单位为纳秒(ns)
+         */
+        void ConfigureDistributedClock(bool enable, uint32_t cycle_time, int32_t sync_shift);
+
+        /**
+         * @brief 配置EtherCAT过程数据组，需要在InitEtherCAT之前调用。
+         * @details 未配置的从站默认属于0组，0组每个周期都会交换数据。其他组每divider个周期交换一次数据，
+         * 可用于将低优先级的从站(如手臂，电池)放入低频组，以减小高频组的帧长度和传输时间。
+         *
+         * @param group 组ID，0组的分频系数固定为1
+         * @param divider 分频系数，该组每divider个总线周期交换一次数据
+         * @param slaves 属于该组的从站ID，从0开始
+         * @return true 配置成功
+         * @return false 配置失败
+         */
+        bool ConfigureProcessDataGroup(uint8_t group, uint32_t divider, const std::vector<size_t>& slaves);
+
+        /**
+         * @brief 查询DC同步模式是否生效
+         *
+         * @return true DC同步模式已开启且从站支持DC
+         * @return false 未开启DC同步模式
+         */
+        bool DistributedClockEnabled() const;
+
+        /**
+         * @brief 获取DC同步模式下内核下一周期的时间修正量，该值由PI控制器在ReadBus中更新。
+         * @details 修正量只在交换了参考时钟所在过程数据组的周期内计算，其余周期为0，因此每次修正只被应用一次。
+         *
+         * @return int64_t 时间修正量，单位为纳秒(ns)
+         */
+        int64_t DistributedClockOffset() const;
+
         /**
          * @brief 写入总线数据，该函数会将数据写入到总线中，该函数会被内核周期性调用。
          *
@@ -107,16 +334,220 @@ namespace bitbot
          */
         std::vector<Encos_VirtualBusDevice*> get_VirtualBusDevices();
 
+        /**
+         * @brief 获取EtherCAT链路统计数据
+         *
+         * @return const EtherCAT_LinkStatistics& 链路统计数据
+         */
+        const EtherCAT_LinkStatistics& GetLinkStatistics() const;
+
+        /**
+         * @brief 查询从站输入数据从哪个周期开始未被更新
+         * @details 当从站所在的帧丢失或工作计数器不足时，该从站的输入数据不再更新，此时挂载在该从站上的设备数据为旧数据。
+         * 若工作计数器不足但无法确定是哪个从站未响应，则所有从站均被标记为未更新。故障从站由总线监督线程每100ms识别一次，
+         * 因此故障开始后的最初若干周期无法归属，所有从站都会被标记；故障从站识别之后，其余从站的标记在下一个工作计数器不足的周期被清除。
+         *
+         * @param slave_id 从站ID，从0开始
+         * @return uint64_t 输入数据开始未更新的周期计数，0表示输入数据为最新
+         */
+        uint64_t InputsStaleSince(size_t slave_id) const;
+
+        /**
+         * @brief 获取总线上的所有电机，按照电机的稠密索引排列
+         *
+         * @return const std::vector<EncosJoint*>& 电机列表
+         */
+        const std::vector<EncosJoint*>& GetJoints() const;
+
+        /**
+         * @brief 获取所有电机的当前转角(rad)，按照电机的稠密索引排列。
+         * @details 以下批量接口返回的数组由总线在ReadBus中更新，仅可在内核循环线程(即用户状态回调)中读取。
+         *
+         * @return std::span<const float> 电机转角
+         */
+        std::span<const float> JointPositions() const;
+
+        /**
+         * @brief 获取所有电机的当前转速(rad/s)
+         *
+         * @return std::span<const float> 电机转速
+         */
+        std::span<const float> JointVelocities() const;
+
+        /**
+         * @brief 获取所有电机的当前电流(A)
+         *
+         * @return std::span<const float> 电机电流
+         */
+        std::span<const float> JointCurrents() const;
+
+        /**
+         * @brief 获取所有电机的当前力矩(Nm)
+         *
+         * @return std::span<const float> 电机力矩
+         */
+        std::span<const float> JointTorques() const;
+
+        /**
+         * @brief 获取所有电机的温度(摄氏度)
+         *
+         * @return std::span<const float> 电机温度
+         */
+        std::span<const float> JointMotorTemperatures() const;
+
+        /**
+         * @brief 获取所有电机驱动器的温度(摄氏度)
+         *
+         * @return std::span<const float> 驱动器温度
+         */
+        std::span<const float> JointDriverTemperatures() const;
+
+        /**
+         * @brief 批量设置电机的运动模式指令，本次调用的所有指令将在下一次WriteBus时同时生效。
+         * @details 指令按照配置文件中的范围限幅，WriteBus不会读到只更新了一部分的指令。WriteBus只应用本次调用之后尚未应用过的电机指令，
+         * 未在joints中出现的电机保持原有指令，包括之后通过EncosJoint::SetTargetMotion等接口设置的指令。
+         * 不处于运动模式或索引无效的电机不会被设置，rejected中对应的元素置1，其余电机的指令照常提交。
+         * 各数组的长度必须与joints相同，否则本次调用不提交任何指令。
+         * 该函数不分配内存，也不输出日志。所有调用必须来自同一个线程，该线程可以与总线线程不同。
+         *
+         * @param joints 电机的稠密索引(见EncosJoint::JointIndex)
+         * @param position 目标转角(rad)
+         * @param velocity 目标转速(rad/s)
+         * @param torque 前馈力矩(Nm)
+         * @param kp 位置环的比例系数
+         * @param kd 位置环的微分系数
+         * @param rejected 每个电机是否未被设置，rejected[k]对应joints[k]
+         * @return true 指令已提交
+         * @return false 数组长度与joints不一致，没有提交任何指令
+         */
+        bool SetJointCommands(std::span<const size_t> joints, std::span<const float> position, std::span<const float> velocity,
+            std::span<const float> torque, std::span<const float> kp, std::span<const float> kd, std::span<uint8_t> rejected);
+
+        /**
+         * @brief 获取最近一个总线周期的整机状态快照，可以在任意线程中调用。
+         * @details 快照在每个周期ReadBus结束后发布一次，读取得到的所有电机和IMU数据均来自同一周期，不会出现部分更新的数据。
+         * 首次调用时会为snapshot分配内存，之后重复使用同一个snapshot不会分配内存。
+         *
+         * @param snapshot 快照
+         * @return true 读取成功
+         * @return false 总线尚未发布过快照
+         */
+        bool GetStateSnapshot(RobotStateSnapshot& snapshot) const;
+
+        /**
+         * @brief 获取用户控制线程(即状态回调所在的内核循环线程)使用的实时日志，只能在该线程中记录日志。
+         * @details 总线读写过程中的日志使用总线内部的另一个实时日志，因此开启独立I/O线程时两个线程不会同时写入同一个日志队列。
+         *
+         * @return EncosRtLogger& 实时日志
+         */
+        EncosRtLogger& GetRtLogger();
+
+        /**
+         * @brief 更新运行时数据，在设备数据之后追加EtherCAT链路统计数据，该函数会被内核周期性调用。
+         *
+         */
+        void UpdateRuntimeData();
+
+        /**
+         * @brief 获取所有设备原始监控采样的总大小，用于异步监控模式。
+         *
+         * @return size_t 原始监控采样的总大小(32位字)
+         */
+        size_t MonitorSampleWords() const;
+
+        /**
+         * @brief 获取EtherCAT链路统计数据的个数，用于异步监控模式。
+         *
+         * @return size_t 链路统计数据个数
+         */
+        size_t LinkMonitorSize() const;
+
+        /**
+         * @brief 拷贝所有设备的原始监控采样和EtherCAT链路统计数据，用于异步监控模式，只能在内核循环线程中调用。
+         *
+         * @param sample 原始监控采样，大小为MonitorSampleWords()
+         * @param link 链路统计数据，大小为LinkMonitorSize()
+         */
+        void CaptureMonitorSample(uint32_t* sample, Number* link);
+
+        /**
+         * @brief 根据原始监控采样生成总线监控数据，用于异步监控模式，只能在监控线程中调用。
+         *
+         * @param sample 由CaptureMonitorSample拷贝的原始监控采样
+         * @param link 由CaptureMonitorSample拷贝的链路统计数据
+         * @param data 总线监控数据将追加到该数组
+         */
+        void UpdateMonitorData(const uint32_t* sample, const Number* link, std::vector<Number>& data);
+
+        /**
+         * @brief 设置内核循环的唤醒抖动统计，该数据将发布在EtherCAT链路统计数据中，只能在内核循环线程中调用。
+         *
+         * @param jitter 唤醒抖动统计
+         */
+        void SetCycleJitter(const EncosCycleJitter& jitter);
+
+        /**
+         * @brief 设置内核循环的超时统计，该数据将发布在EtherCAT链路统计数据中，只能在内核循环线程中调用。
+         *
+         * @param stat 超时统计
+         */
+        void SetOverrunStatistics(const EncosOverrunStatistics& stat);
+
 
     private:
         // bitbot bus variables
-        std::vector<std::vector<Encos_CANBusDevice*>> CAN_Device_By_EtherCAT_ID; // for device write
-        std::map<size_t, std::vector<Encos_CANBusDevice*>> CAN_Device_By_CAN_ID; // for device read
+        std::vector<std::vector<Encos_CANBusDevice*>> CAN_Device_By_EtherCAT_ID; // device slots of each slave, only used in Init()
         std::vector<Encos_VirtualBusDevice*> VirtualBusDevices;
 
+        // flat routing table built in Init(), the bus loop does no lookup and no allocation.
+        static constexpr size_t K_CAN_ID_SPACE = 0x800; // 11-bit standard CAN id
+        static constexpr size_t K_CAN_SLOT_NUM = 6; // slots of EtherCAT_Msg::device
+        static constexpr size_t K_CAN_SLOTS_PER_CHANNEL = 3; // slot 1~3 for CAN1, slot 4~6 for CAN2
+        static constexpr size_t K_CAN_SLOT_INTERVAL_US = 50; // dispatch interval of the gateway inside one CAN channel
+        std::vector<CAN_SlotEntry> CAN_WriteRoute; // schedule entries ordered by slave and slot, for device write
+        std::vector<CAN_RouteSpan> CAN_SlotSpan; // span of each slot in CAN_WriteRoute
+        std::vector<CAN_RouteSpan> CAN_WriteSpan; // span of the slots of each slave in CAN_SlotSpan
+        std::vector<Encos_CANBusDevice*> CAN_ReadRoute; // devices grouped by slave and CAN id, for device read
+        std::vector<EncosJoint*> CAN_ReadJoint; // same layout as CAN_ReadRoute, the joint whose motion replies are batch decoded, nullptr otherwise
+        std::vector<CAN_RouteSpan> CAN_ReadSpan; // span of each CAN id in CAN_ReadRoute, indexed by slave * K_CAN_ID_SPACE + CAN id
+
+        void UpdateLinkMonitorData();
+
         std::vector<EtherCAT_Msg*> CAN_BusReadBuffer;
         std::vector<EtherCAT_Msg*> CAN_BusWriteBuffer;
 
+        // dense joint index and struct-of-arrays joint state
+        std::vector<EncosJoint*> Joints;
+        JointStateTable JointStates;
+
+        // whole robot state published once per cycle for other threads
+        static constexpr size_t K_IMU_SNAPSHOT_WORDS = sizeof(ImuStateSnapshot) / sizeof(uint32_t);
+        std::vector<YesenseIMU*> Imus;
+        EncosSeqLock StateSnapshot;
+
+        void PublishStateSnapshot();
+
+        // ack type 1 replies of all joints are gathered in ReadBus and decoded in one pass
+        EncosJointReplyBatch JointReplyBatch;
+
+        bool GatherJointReply(EncosJoint* joint, const CAN_Device_Msg& frame);
+
+        // motion commands of all joints are quantized in one pass before the frames are sent
+        EncosJointCommandBatch JointCommandBatch;
+
+        bool GatherJointCommand(EncosJoint* joint, CAN_Device_Msg& frame);
+
+        // bulk motion commands are published through a mailbox, the writer and WriteBus never wait for each other
+        JointCommandTable JointCommandStaging; // latest commands of the writer thread
+        uint64_t JointCommandSeq = 0; // last commit of the writer thread
+        uint64_t JointCommandApplied = 0; // last commit applied by WriteBus
+        JointCommandTable JointCommandMin; // clamp limits of each joint, filled in Init()
+        JointCommandTable JointCommandMax;
+        EncosMailbox<JointCommandTable> JointCommandMailbox;
+
+        void ApplyJointCommands();
+        void PublishJointReplies();
+
 
 
     private:
@@ -133,10 +564,70 @@ namespace bitbot
         static constexpr int K_ETHERCAT_ERR_PERIOD = 100;
         static constexpr int K_ETHERCAT_ERR_MAX = 20;
         static constexpr int EC_TIMEOUTMON = 500;
-        static constexpr size_t currentgroup = 0;
 
-        void EtherCATStateCheck();
-        static constexpr size_t check_cycle = 100;
-        size_t check_cnt = 1;
+        // process data groups, group 0 is exchanged every cycle, other groups every GroupDivider cycles.
+        // group g is mapped as soem group g + 1, soem group 0 would map all slaves.
+        static constexpr size_t K_MAX_GROUP = 2;
+        static constexpr uint8_t SoemGroup(size_t group)
+        {
+            return static_cast<uint8_t>(group + 1);
+        }
+        std::vector<std::pair<size_t, uint8_t>> SlaveGroupConfig; // (slave, group) from configuration
+        std::vector<uint8_t> SlaveGroup; // group of each slave
+        uint32_t GroupDivider[K_MAX_GROUP] = { 1, 1 };
+        int GroupExpectedWKC[K_MAX_GROUP] = { 0, 0 };
+        bool GroupUsed[K_MAX_GROUP] = { false, false };
+        bool GroupExchanged[K_MAX_GROUP] = { false, false };
+        int DcGroup = -1; // group of the DC reference clock whose first frame carries the DC datagram, -1 without DC slaves
+        int cycle_expected_wkc = 0;
+
+        void SendProcessData();
+        int ReceiveProcessData();
+
+        // distributed clock related variables
+        bool dc_enable = false;
+        int64_t dc_cycle_time = 1000000; // ns
+        int32_t dc_sync_shift = 0; // ns
+        int64_t dc_integral = 0;
+        int64_t dc_offset_time = 0; // ns
+
+        void DistributedClockSync(int64_t reftime);
+        void BuildRouteTable();
+        bool AllocateSlots(size_t slave, std::vector<std::vector<CAN_SlotEntry>>& slots);
+        void EtherCATStateCheck(bool wkc_short);
+
+        // per cycle working counter accounting
+        EtherCAT_LinkStatistics LinkStatistics;
+        std::vector<uint64_t> SlaveInputsStaleSince; // 0 means inputs are fresh
+        std::unique_ptr<std::atomic_bool[]> SlaveFault; // written by the supervisor, read by the bus loop
+        std::vector<Number> LinkMonitorData;
+        EncosCycleJitter CycleJitter; // set by the thread which runs the bus loop
+        EncosOverrunStatistics OverrunStatistics; // published by the kernel loop
+
+        // logs of the bus loop are formatted and written by the background thread of RtLogger,
+        // logs of the user control thread go to ControlRtLogger, each queue has a single producer
+        EncosRtLogger RtLogger;
+        EncosRtLogger ControlRtLogger;
+
+        // link statistics, wakeup jitter and stale inputs published by the bus loop for the monitor,
+        // which runs in another thread when the EtherCAT I/O thread is enabled
+        EncosSeqLock LinkSnapshot;
+        std::vector<uint32_t> LinkSnapshotWords;
+        void PublishLinkSnapshot();
+
+        void UpdateLinkStatistics();
+
+        // slave state monitoring and recovery run in a low priority supervisor thread,
+        // the bus loop only reports the working counter through a lock-free queue.
+        static constexpr int K_SUPERVISOR_PERIOD_MS = 100; // the old inline check ran every 100 cycles at 1 kHz, K_ETHERCAT_ERR_PERIOD counts these checks
+        static constexpr size_t K_SUPERVISOR_QUEUE_SIZE = 1024;
+        moodycamel::ReaderWriterQueue<EtherCAT_CycleReport> SupervisorQueue{ K_SUPERVISOR_QUEUE_SIZE };
+        std::atomic_bool SupervisorRun = false;
+        std::thread SupervisorThread;
+        uint64_t cycle_cnt = 0;
+
+        void StartSupervisor();
+        void StopSupervisor();
+        void SupervisorLoop();
     };
 };
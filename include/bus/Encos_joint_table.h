@@ -0,0 +1,149 @@
+/**
+ * @file Encos_joint_table.h
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos joint state table header file
+ * @details 总线持有的电机状态表和指令表，按结构体数组(SoA)方式存储所有电机的状态和指令，便于一次性读写整机数据。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+#include "cstddef"
+#include "cstdint"
+#include "new"
+#include "vector"
+
+namespace bitbot
+{
+    /**
+     * @brief 按缓存行对齐的内存分配器。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     * @tparam T 元素类型
+     */
+    template <typename T>
+    struct CacheAlignedAllocator
+    {
+        using value_type = T;
+        static constexpr std::size_t K_CACHE_LINE = 64;
+
+        CacheAlignedAllocator() noexcept = default;
+
+        template <typename U>
+        CacheAlignedAllocator(const CacheAlignedAllocator<U>&) noexcept
+        {
+        }
+
+        T* allocate(std::size_t n)
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(K_CACHE_LINE)));
+        }
+
+        void deallocate(T* p, std::size_t) noexcept
+        {
+            ::operator delete(p, std::align_val_t(K_CACHE_LINE));
+        }
+
+        template <typename U>
+        bool operator==(const CacheAlignedAllocator<U>&) const noexcept
+        {
+            return true;
+        }
+    };
+
+    /**
+     * @brief 电机状态表，每个数组按电机的稠密索引(见EncosJoint::JointIndex)排列。
+     * @details 该表由总线在ReadBus中写入，仅在内核循环线程(即用户状态回调所在线程)中读取是安全的。
+     *
+     */
+    struct JointStateTable
+    {
+        template <typename T>
+        using Array = std::vector<T, CacheAlignedAllocator<T>>;
+
+        /// @brief 电机当前转角(rad)
+        Array<float> position;
+        /// @brief 电机当前转速(rad/s)
+        Array<float> velocity;
+        /// @brief 电机当前电流(A)
+        Array<float> current;
+        /// @brief 电机当前力矩(Nm)
+        Array<float> torque;
+        /// @brief 电机当前温度(摄氏度)
+        Array<float> motor_temperature;
+        /// @brief 驱动器当前温度(摄氏度)
+        Array<float> driver_temperature;
+
+        /**
+         * @brief 分配状态表
+         *
+         * @param n 电机数量
+         */
+        void Resize(std::size_t n)
+        {
+            for (auto v : { &this->position, &this->velocity, &this->current, &this->torque, &this->motor_temperature, &this->driver_temperature })
+            {
+                v->assign(n, 0.0f);
+            }
+        }
+
+        /**
+         * @brief 获取电机数量
+         *
+         * @return std::size_t 电机数量
+         */
+        std::size_t Size() const
+        {
+            return this->position.size();
+        }
+    };
+
+    /**
+     * @brief 电机运动模式指令表，每个数组按电机的稠密索引(见EncosJoint::JointIndex)排列。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct JointCommandTable
+    {
+        template <typename T>
+        using Array = JointStateTable::Array<T>;
+
+        /// @brief 电机目标转角(rad)
+        Array<float> position;
+        /// @brief 电机目标转速(rad/s)
+        Array<float> velocity;
+        /// @brief 电机前馈力矩(Nm)
+        Array<float> torque;
+        /// @brief 运动模式下位置环的比例系数
+        Array<float> kp;
+        /// @brief 运动模式下位置环的微分系数
+        Array<float> kd;
+        /// @brief 最近一次设置该电机的批量指令序号，0表示从未设置
+        Array<uint64_t> stamp;
+        /// @brief 该表包含的最新批量指令序号
+        uint64_t seq = 0;
+
+        /**
+         * @brief 分配指令表
+         *
+         * @param n 电机数量
+         */
+        void Resize(std::size_t n)
+        {
+            for (auto v : { &this->position, &this->velocity, &this->torque, &this->kp, &this->kd })
+            {
+                v->assign(n, 0.0f);
+            }
+            this->stamp.assign(n, 0);
+            this->seq = 0;
+        }
+
+        /**
+         * @brief 获取电机数量
+         *
+         * @return std::size_t 电机数量
+         */
+        std::size_t Size() const
+        {
+            return this->position.size();
+        }
+    };
+}
@@ -0,0 +1,216 @@
+/**
+ * @file Encos_rt_logger.h
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos real-time logger header file
+ * @details 实时线程使用的异步日志。实时线程只记录事件和少量数值参数，格式化和写入文件由后台线程完成。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+#include "atomic"
+#include "concepts"
+#include "cstdint"
+#include "string_view"
+#include "thread"
+#include "bitbot_kernel/utils/logger.h"
+#include "spdlog/fmt/fmt.h"
+#include "readerwriterqueue.h"
+
+namespace bitbot
+{
+    /**
+     * @brief 日志事件，每个事件对应一条固定的日志格式。事件应定义为静态常量，日志记录中只保存事件的地址。
+     *
+     */
+    struct EncosLogEvent
+    {
+        /// @brief 日志等级
+        spdlog::level::level_enum level;
+        /// @brief fmt格式字符串，最多引用4个参数
+        const char* format;
+    };
+
+    /**
+     * @brief 日志参数，只能是整数，浮点数或具有静态存储期的字符串。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct EncosLogArg
+    {
+        enum class Type : uint8_t
+        {
+            Int,
+            UInt,
+            Float,
+            String
+        };
+
+        Type type = Type::Int;
+        union
+        {
+            int64_t i = 0;
+            uint64_t u;
+            double f;
+            const char* s;
+        };
+
+        EncosLogArg() = default;
+
+        template <std::signed_integral T>
+        EncosLogArg(T v)
+            : type(Type::Int), i(v)
+        {
+        }
+
+        template <std::unsigned_integral T>
+        EncosLogArg(T v)
+            : type(Type::UInt), u(v)
+        {
+        }
+
+        template <std::floating_point T>
+        EncosLogArg(T v)
+            : type(Type::Float), f(v)
+        {
+        }
+
+        EncosLogArg(const char* v)
+            : type(Type::String), s(v)
+        {
+        }
+    };
+
+    /**
+     * @brief 实时日志记录，固定大小，入队时不分配内存。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct EncosLogRecord
+    {
+        static constexpr size_t K_MAX_ARGS = 4;
+
+        /// @brief 日志事件
+        const EncosLogEvent* event = nullptr;
+        /// @brief 日志参数
+        EncosLogArg args[K_MAX_ARGS];
+    };
+
+    /**
+     * @brief 实时线程日志，单生产者单消费者。
+     * @details 实时线程调用Post记录日志，Post只写入预先分配的环形队列，既不分配内存也不访问文件，队列满时丢弃日志并计数。
+     * 后台线程周期性地取出日志，格式化后写入spdlog。未启动后台线程时Post直接写入spdlog，用于初始化阶段。
+     * 每个EncosRtLogger只能有一个线程调用Post。
+     *
+     */
+    class EncosRtLogger
+    {
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param capacity 队列容量(条)
+         */
+        explicit EncosRtLogger(size_t capacity = K_DEFAULT_CAPACITY);
+
+        /**
+         * @brief 析构函数，停止后台线程并写出队列中剩余的日志
+         *
+         */
+        ~EncosRtLogger();
+
+        /**
+         * @brief 启动后台线程
+         *
+         * @param logger 日志写入的spdlog日志器
+         */
+        void Start(SpdLoggerSharedPtr logger);
+
+        /**
+         * @brief 停止后台线程并写出队列中剩余的日志
+         *
+         */
+        void Stop();
+
+        /**
+         * @brief 记录一条日志
+         *
+         * @tparam Args 参数类型
+         * @param event 日志事件
+         * @param args 参数，最多4个
+         */
+        template <typename... Args>
+        void Post(const EncosLogEvent& event, Args... args)
+        {
+            static_assert(sizeof...(Args) <= EncosLogRecord::K_MAX_ARGS, "too many arguments for a real-time log record");
+            EncosLogRecord record{ &event, { EncosLogArg(args)... } };
+            if (!this->Running.load(std::memory_order_acquire)) [[unlikely]]
+            {
+                this->Write(record);
+                return;
+            }
+            if (!this->Queue.try_enqueue(record)) [[unlikely]]
+            {
+                this->Dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief 获取因队列已满而丢弃的日志条数
+         *
+         * @return uint64_t 丢弃的日志条数
+         */
+        uint64_t DroppedCount() const;
+
+    private:
+        static constexpr size_t K_DEFAULT_CAPACITY = 4096;
+        static constexpr int K_FLUSH_PERIOD_MS = 5;
+
+        SpdLoggerSharedPtr Logger;
+        moodycamel::ReaderWriterQueue<EncosLogRecord> Queue;
+        std::atomic<uint64_t> Dropped = 0;
+        uint64_t DroppedReported = 0;
+        std::atomic_bool Running = false;
+        std::thread Worker;
+
+        void WorkerLoop();
+        void Drain();
+        void Write(const EncosLogRecord& record);
+    };
+}
+
+/**
+ * @brief 日志参数的格式化器，格式说明(如{:02X})作用于参数的实际类型。
+ *
+ */
+template <>
+struct fmt::formatter<bitbot::EncosLogArg>
+{
+    char spec[32] = "{:";
+    size_t length = 2;
+
+    constexpr auto parse(fmt::format_parse_context& ctx) -> decltype(ctx.begin())
+    {
+        auto it = ctx.begin();
+        while (it != ctx.end() && *it != '}' && this->length < sizeof(this->spec) - 1)
+        {
+            this->spec[this->length++] = *it++;
+        }
+        this->spec[this->length++] = '}';
+        return it;
+    }
+
+    auto format(const bitbot::EncosLogArg& arg, fmt::format_context& ctx) const -> decltype(ctx.out())
+    {
+        const auto fmt_str = fmt::runtime(std::string_view(this->spec, this->length));
+        switch (arg.type)
+        {
+        case bitbot::EncosLogArg::Type::Int:
+            return fmt::format_to(ctx.out(), fmt_str, arg.i);
+        case bitbot::EncosLogArg::Type::UInt:
+            return fmt::format_to(ctx.out(), fmt_str, arg.u);
+        case bitbot::EncosLogArg::Type::Float:
+            return fmt::format_to(ctx.out(), fmt_str, arg.f);
+        default:
+            return fmt::format_to(ctx.out(), fmt_str, arg.s);
+        }
+    }
+};
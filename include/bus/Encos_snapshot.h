@@ -0,0 +1,176 @@
+/**
+ * @file Encos_snapshot.h
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos state snapshot header file
+ * @details 总线每个周期发布一次的整机状态快照。快照使用顺序锁(seqlock)发布，其他线程读取时总能得到同一周期的完整数据。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+#include "atomic"
+#include "cstdint"
+#include "cstring"
+#include "thread"
+#include "vector"
+#include "bus/Encos_joint_table.h"
+
+namespace bitbot
+{
+    /**
+     * @brief IMU状态快照
+     *
+     */
+    struct ImuStateSnapshot
+    {
+        /// @brief 滚转角度(rad)
+        float roll = 0;
+        /// @brief 俯仰角度(rad)
+        float pitch = 0;
+        /// @brief 偏航角度(rad)
+        float yaw = 0;
+        /// @brief x轴加速度(m/s^2)
+        float acc_x = 0;
+        /// @brief y轴加速度(m/s^2)
+        float acc_y = 0;
+        /// @brief z轴加速度(m/s^2)
+        float acc_z = 0;
+        /// @brief x轴角速度(rad/s)
+        float gyro_x = 0;
+        /// @brief y轴角速度(rad/s)
+        float gyro_y = 0;
+        /// @brief z轴角速度(rad/s)
+        float gyro_z = 0;
+        /// @brief 温度(°C)
+        float temperature = 0;
+    };
+
+    /**
+     * @brief 整机状态快照，包含所有电机和IMU在同一总线周期内的状态。
+     * @details 电机数组按照电机的稠密索引(见EncosJoint::JointIndex)排列，IMU数组按照设备ID从小到大排列。
+     *
+     */
+    struct RobotStateSnapshot
+    {
+        /// @brief 快照对应的总线周期计数
+        uint64_t cycle = 0;
+
+        /// @brief 电机当前转角(rad)
+        std::vector<float> position;
+        /// @brief 电机当前转速(rad/s)
+        std::vector<float> velocity;
+        /// @brief 电机当前电流(A)
+        std::vector<float> current;
+        /// @brief 电机当前力矩(Nm)
+        std::vector<float> torque;
+        /// @brief 电机当前温度(摄氏度)
+        std::vector<float> motor_temperature;
+        /// @brief 驱动器当前温度(摄氏度)
+        std::vector<float> driver_temperature;
+
+        /// @brief IMU状态
+        std::vector<ImuStateSnapshot> imu;
+
+        /// @brief 读取时使用的缓冲区，用户无需关心
+        std::vector<uint32_t> raw;
+    };
+
+    /**
+     * @brief 单写者多读者的顺序锁缓冲区。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     * @details 写者在写入前后各递增一次序号，读者在序号为偶数且读取前后序号一致时得到完整数据。
+     * 缓冲区按32位字使用relaxed原子操作访问，在x86和ARM上编译为普通的读写指令。
+     *
+     */
+    class EncosSeqLock
+    {
+    public:
+        /**
+         * @brief 分配缓冲区，只能在没有读者和写者时调用
+         *
+         * @param words 缓冲区大小(32位字)
+         */
+        void Resize(size_t words)
+        {
+            this->Words.assign(words, 0);
+        }
+
+        /**
+         * @brief 获取缓冲区大小
+         *
+         * @return size_t 缓冲区大小(32位字)
+         */
+        size_t Size() const
+        {
+            return this->Words.size();
+        }
+
+        /**
+         * @brief 开始写入，只能由唯一的写者调用
+         *
+         */
+        void BeginWrite()
+        {
+            this->Sequence.store(this->Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        /**
+         * @brief 写入数据
+         *
+         * @param offset 写入位置(32位字)
+         * @param src 数据
+         * @param words 数据大小(32位字)
+         */
+        void Store(size_t offset, const void* src, size_t words)
+        {
+            const uint8_t* p = static_cast<const uint8_t*>(src);
+            for (size_t i = 0; i < words; i++)
+            {
+                uint32_t w;
+                std::memcpy(&w, p + i * sizeof(uint32_t), sizeof(uint32_t));
+                std::atomic_ref<uint32_t>(this->Words[offset + i]).store(w, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief 结束写入
+         *
+         */
+        void EndWrite()
+        {
+            this->Sequence.store(this->Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 读取完整的缓冲区，读取过程中如果写者正在写入则重试
+         *
+         * @param dst 目标缓冲区，大小至少为Size()
+         * @return uint64_t 读取到的序号，0表示尚未写入过数据
+         */
+        uint64_t Read(uint32_t* dst) const
+        {
+            uint64_t begin, end;
+            do
+            {
+                begin = this->Sequence.load(std::memory_order_acquire);
+                while (begin & 1) // the writer is publishing, it never blocks so the wait is short
+                {
+                    std::this_thread::yield();
+                    begin = this->Sequence.load(std::memory_order_acquire);
+                }
+
+                for (size_t i = 0; i < this->Words.size(); i++)
+                {
+                    dst[i] = std::atomic_ref<uint32_t>(const_cast<uint32_t&>(this->Words[i])).load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                end = this->Sequence.load(std::memory_order_relaxed);
+            } while (begin != end);
+            return begin;
+        }
+
+    private:
+        alignas(64) std::atomic<uint64_t> Sequence = 0;
+        JointStateTable::Array<uint32_t> Words;
+    };
+}
@@ -0,0 +1,388 @@
+/**
+ * @file Encos_codec.hpp
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos CAN frame codec header file
+ * @details Encos电机CAN帧编解码工具。每种帧格式由若干位域声明式地描述，编解码在编译期展开为移位和掩码操作。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "bus/Encos_bus_msg.h"
+
+namespace bitbot
+{
+    /**
+     * @brief Encos CAN帧中的位域描述。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     * @details 位域按照高位在前的顺序排列，Offset为该位域最高位相对于data[0]最高位的偏移。
+     *
+     * @tparam Offset 位域起始位置(bit)
+     * @tparam Bits 位域长度(bit)
+     */
+    template <size_t Offset, size_t Bits>
+    struct EncosBitField
+    {
+        static_assert(Bits > 0 && Bits <= 32, "Encos bit field must be 1~32 bits");
+        static_assert(Offset + Bits <= 64, "Encos bit field exceeds the 8 bytes CAN payload");
+
+        static constexpr size_t offset = Offset;
+        static constexpr size_t bits = Bits;
+        static constexpr size_t shift = 64 - Offset - Bits;
+        static constexpr uint32_t max = static_cast<uint32_t>((uint64_t(1) << Bits) - 1);
+        static constexpr uint64_t mask = uint64_t(max) << shift;
+
+        /**
+         * @brief 将数值写入帧数据字
+         *
+         * @param word 高位在前的64位帧数据字
+         * @param value 数值，超出位宽的部分将被截断
+         */
+        static constexpr void Put(uint64_t& word, uint32_t value)
+        {
+            word = (word & ~mask) | ((uint64_t(value) & max) << shift);
+        }
+
+        /**
+         * @brief 从帧数据字中读取数值
+         *
+         * @param word 高位在前的64位帧数据字
+         * @return uint32_t 数值
+         */
+        static constexpr uint32_t Get(uint64_t word)
+        {
+            return static_cast<uint32_t>((word >> shift) & max);
+        }
+    };
+
+    /**
+     * @brief Encos CAN帧格式，由若干互不重叠的位域组成。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     * @tparam DLC 帧数据长度
+     * @tparam Fields 帧中的位域
+     */
+    template <uint8_t DLC, typename... Fields>
+    struct EncosFrameLayout
+    {
+    private:
+        static constexpr bool Disjoint()
+        {
+            uint64_t used = 0;
+            bool disjoint = true;
+            ((disjoint = disjoint && (used & Fields::mask) == 0, used |= Fields::mask), ...);
+            return disjoint;
+        }
+
+    public:
+        static_assert(DLC <= 8, "CAN payload is at most 8 bytes");
+        static_assert(Disjoint(), "bit fields of an Encos frame must not overlap");
+        static_assert(((Fields::offset + Fields::bits <= DLC * 8u) && ...), "bit field exceeds the frame length");
+
+        static constexpr uint8_t dlc = DLC;
+
+        /**
+         * @brief 按照位域声明顺序打包帧数据
+         *
+         * @param data CAN消息
+         * @param values 各位域的数值
+         */
+        static constexpr void Pack(CAN_Device_Msg& data, typename std::conditional<true, uint32_t, Fields>::type... values)
+        {
+            uint64_t word = 0;
+            (Fields::Put(word, values), ...);
+            Store(data, word);
+            data.dlc = DLC;
+            data.rtr = 0;
+        }
+
+        /**
+         * @brief 将CAN消息数据转换为高位在前的64位帧数据字
+         *
+         * @param data CAN消息
+         * @return uint64_t 帧数据字
+         */
+        static constexpr uint64_t Load(const CAN_Device_Msg& data)
+        {
+            if (std::is_constant_evaluated())
+            {
+                uint64_t word = 0;
+                for (size_t i = 0; i < 8; i++)
+                {
+                    word = (word << 8) | data.data[i];
+                }
+                return word;
+            }
+            // CAN_Device_Msg is packed, a byte loop is not merged into one load by the compiler
+            uint64_t word;
+            std::memcpy(&word, data.data, sizeof(word));
+            return ToBigEndian(word);
+        }
+
+    private:
+        static constexpr uint64_t ToBigEndian(uint64_t word)
+        {
+            if constexpr (std::endian::native == std::endian::little)
+                return __builtin_bswap64(word);
+            else
+                return word;
+        }
+
+        static constexpr void Store(CAN_Device_Msg& data, uint64_t word)
+        {
+            if (std::is_constant_evaluated())
+            {
+                for (size_t i = 0; i < 8; i++)
+                {
+                    data.data[i] = static_cast<uint8_t>(word >> (56 - 8 * i));
+                }
+                return;
+            }
+            const uint64_t be = ToBigEndian(word);
+            std::memcpy(data.data, &be, sizeof(be));
+        }
+    };
+
+    /**
+     * @brief Encos定点数线性量化参数，在配置时预先计算，编解码时无需除法。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct EncosLinearScale
+    {
+        /// @brief 量化范围下限
+        float min = 0;
+        /// @brief 浮点数到整数的缩放系数
+        float to_int = 1;
+        /// @brief 整数到浮点数的缩放系数
+        float to_float = 1;
+        /// @brief 整数最大值
+        uint32_t max = 0;
+
+        /**
+         * @brief 根据量化范围和位宽计算量化参数
+         *
+         * @param x_min 量化范围下限
+         * @param x_max 量化范围上限
+         * @param bits 位宽
+         * @return EncosLinearScale 量化参数
+         */
+        static constexpr EncosLinearScale Make(float x_min, float x_max, size_t bits)
+        {
+            EncosLinearScale scale;
+            const float span = x_max - x_min;
+            scale.min = x_min;
+            scale.max = static_cast<uint32_t>((uint64_t(1) << bits) - 1);
+            scale.to_int = span > 0 ? static_cast<float>(scale.max) / span : 0.0f;
+            scale.to_float = span / static_cast<float>(scale.max);
+            return scale;
+        }
+
+        /**
+         * @brief 将浮点数量化为整数，四舍五入并饱和到量化范围内
+         *
+         * @note 位宽不超过 24 位，此时上限可由 float 精确表示，帧内字段均满足
+         *
+         * @param x 浮点数
+         * @return uint32_t 量化后的整数
+         */
+        uint32_t Encode(float x) const
+        {
+            // selects instead of branches so that loops over joints are vectorized, NaN fails the first comparison and becomes 0
+            const float max = static_cast<float>(this->max);
+            float v = (x - this->min) * this->to_int + 0.5f;
+            v = v > 0.0f ? v : 0.0f;
+            v = v < max ? v : max;
+            return static_cast<uint32_t>(v);
+        }
+
+        /**
+         * @brief 将整数反量化为浮点数
+         *
+         * @param x 量化后的整数
+         * @return float 浮点数
+         */
+        constexpr float Decode(uint32_t x) const
+        {
+            return static_cast<float>(x) * this->to_float + this->min;
+        }
+    };
+
+    /**
+     * @brief 批量量化，与逐个调用EncosLinearScale::Encode的结果逐位相同。该函数仅适用于开发者使用，用户无需关心其实现细节。
+     * @details 循环中没有分支，编译器可以将其向量化。比较写成选择运算而不是std::fmin/fmax，后者为了NaN语义不能内联为向量指令；
+     * v > 0不成立时(包括NaN)结果为0，与Encode一致。
+     *
+     * @param n 数量
+     * @param x 浮点数
+     * @param mul 每个数的缩放系数，即EncosLinearScale::to_int
+     * @param min 每个数的量化范围下限
+     * @param max 整数最大值，不能超过INT32_MAX
+     * @param out 量化后的整数
+     */
+    inline void EncosQuantizeBatch(size_t n, const float* __restrict x, const float* __restrict mul, const float* __restrict min, float max, uint32_t* __restrict out)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            float v = (x[i] - min[i]) * mul[i] + 0.5f;
+            v = v > 0.0f ? v : 0.0f;
+            v = v < max ? v : max;
+            out[i] = static_cast<uint32_t>(static_cast<int32_t>(v)); // signed conversion has a vector instruction
+        }
+    }
+
+    /**
+     * @brief 将无符号定点数四舍五入并饱和到[0, max]范围内。
+     *
+     * @param x 浮点数
+     * @param max 整数最大值
+     * @return uint32_t 四舍五入并饱和后的整数
+     */
+    inline uint32_t EncosSaturateUInt(float x, uint32_t max)
+    {
+        const float v = x + 0.5f;
+        if (!(v > 0.0f)) // also catches NaN
+            return 0;
+        if (v >= static_cast<float>(max))
+            return max;
+        return static_cast<uint32_t>(v);
+    }
+
+    /**
+     * @brief 将有符号定点数饱和到int16范围内，用于电流/力矩指令。
+     *
+     * @param x 浮点数
+     * @return int16_t 四舍五入并饱和后的整数
+     */
+    inline int16_t EncosSaturateInt16(float x)
+    {
+        if (!(x == x)) // NaN
+            return 0;
+        return static_cast<int16_t>(std::lround(std::fmax(std::fmin(x, 32767.0f), -32768.0f)));
+    }
+
+    /**
+     * @brief Encos电机的帧格式定义，每个帧格式对应电机协议中的一种报文。
+     *
+     */
+    namespace EncosFrame
+    {
+        using Header = EncosBitField<0, 3>;
+
+        /// @brief 运动模式控制指令
+        struct MotionCommand
+        {
+            using Kp = EncosBitField<3, 12>;
+            using Kd = EncosBitField<15, 9>;
+            using Position = EncosBitField<24, 16>;
+            using Velocity = EncosBitField<40, 12>;
+            using Torque = EncosBitField<52, 12>;
+            using Layout = EncosFrameLayout<8, Header, Kp, Kd, Position, Velocity, Torque>;
+            static constexpr uint32_t header = 0x0;
+        };
+
+        /// @brief 位置模式控制指令
+        struct PositionCommand
+        {
+            using Position = EncosBitField<3, 32>; // IEEE754 float, degree
+            using Velocity = EncosBitField<35, 15>; // 0.1rpm
+            using Current = EncosBitField<50, 12>; // 0.1A
+            using AckType = EncosBitField<62, 2>;
+            using Layout = EncosFrameLayout<8, Header, Position, Velocity, Current, AckType>;
+            static constexpr uint32_t header = 0x1;
+        };
+
+        /// @brief 速度模式控制指令
+        struct VelocityCommand
+        {
+            using Reserved = EncosBitField<3, 3>;
+            using AckType = EncosBitField<6, 2>;
+            using Velocity = EncosBitField<8, 32>; // IEEE754 float, rpm
+            using Current = EncosBitField<40, 16>; // 0.1A
+            using Layout = EncosFrameLayout<7, Header, Reserved, AckType, Velocity, Current>;
+            static constexpr uint32_t header = 0x2;
+        };
+
+        /// @brief 电流/力矩模式控制指令
+        struct CurrentCommand
+        {
+            using Reserved = EncosBitField<3, 1>;
+            using CtrlStatus = EncosBitField<4, 2>; // 0: current, 1: torque
+            using AckType = EncosBitField<6, 2>;
+            using Value = EncosBitField<8, 16>; // int16, 0.01A or 0.01Nm
+            using Layout = EncosFrameLayout<3, Header, Reserved, CtrlStatus, AckType, Value>;
+            static constexpr uint32_t header = 0x3;
+        };
+
+        /// @brief 参数设置指令
+        struct SettingsCommand
+        {
+            using AckType = EncosBitField<3, 5>;
+            using Code = EncosBitField<8, 8>;
+            using Value0 = EncosBitField<16, 16>;
+            using Value1 = EncosBitField<32, 16>;
+            using Layout4 = EncosFrameLayout<4, Header, AckType, Code, Value0>;
+            using Layout6 = EncosFrameLayout<6, Header, AckType, Code, Value0, Value1>;
+            static constexpr uint32_t header = 0x6;
+        };
+
+        /// @brief 备用ID(0x7FF)上的配置指令
+        struct AlternativeCommand
+        {
+            using MotorID = EncosBitField<0, 16>;
+            using Reserved = EncosBitField<16, 8>;
+            using Code = EncosBitField<24, 8>;
+            using Layout = EncosFrameLayout<4, MotorID, Reserved, Code>;
+        };
+
+        /// @brief 应答帧的公共报头
+        struct ReplyHeader
+        {
+            using AckType = EncosBitField<0, 3>;
+            using ErrorCode = EncosBitField<3, 5>;
+        };
+
+        /// @brief 应答类型1: 位置，速度，电流和温度
+        struct ReplyType1
+        {
+            using Position = EncosBitField<8, 16>;
+            using Velocity = EncosBitField<24, 12>;
+            using Current = EncosBitField<36, 12>;
+            using MotorTemperature = EncosBitField<48, 8>;
+            using DriverTemperature = EncosBitField<56, 8>;
+            using Layout = EncosFrameLayout<8, ReplyHeader::AckType, ReplyHeader::ErrorCode, Position, Velocity, Current, MotorTemperature, DriverTemperature>;
+        };
+
+        /// @brief 应答类型2/3: 浮点位置(度)或速度(rpm)，电流和温度
+        struct ReplyType2
+        {
+            using Value = EncosBitField<8, 32>; // IEEE754 float
+            using Current = EncosBitField<40, 16>; // int16, 0.01A
+            using MotorTemperature = EncosBitField<56, 8>;
+            using Layout = EncosFrameLayout<8, ReplyHeader::AckType, ReplyHeader::ErrorCode, Value, Current, MotorTemperature>;
+        };
+
+        /// @brief 应答类型4: 参数设置结果
+        struct ReplyType4
+        {
+            using Code = EncosBitField<8, 8>;
+            using Result = EncosBitField<16, 8>;
+            using Layout = EncosFrameLayout<3, ReplyHeader::AckType, ReplyHeader::ErrorCode, Code, Result>;
+        };
+
+        /**
+         * @brief 将温度字节转换为摄氏度
+         *
+         * @param raw 温度字节
+         * @return float 温度(摄氏度)
+         */
+        constexpr float DecodeTemperature(uint32_t raw)
+        {
+            return (static_cast<float>(raw) - 50.0f) * 0.5f;
+        }
+    }
+}
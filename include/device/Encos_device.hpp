@@ -9,7 +9,10 @@
 #pragma once
 
 #include "bitbot_kernel/device/device.hpp"
+#include "bitbot_kernel/utils/cpu_affinity.h"
 #include "bus/Encos_bus_msg.h"
+#include "atomic"
+#include "thread"
 #include "vector"
 
 namespace bitbot
@@ -68,6 +71,36 @@ namespace bitbot
         constexpr virtual bool VirtualBusDevice() const = 0;
 
     protected:
+        /**
+         * @brief 获取设备原始监控采样的大小，用于异步监控模式。
+         * @details 异步监控模式下，内核循环每个周期只调用CaptureMonitorSample拷贝设备的原始状态，
+         * 监控线程再调用UpdateMonitorData将原始状态转换为监控数据。未实现这三个函数的设备在异步监控模式下不更新监控数据。
+         *
+         * @return size_t 原始监控采样的大小(32位字)
+         */
+        virtual size_t MonitorSampleWords() const
+        {
+            return 0;
+        }
+
+        /**
+         * @brief 拷贝设备的原始监控采样，该函数在内核循环线程中调用，应当只拷贝数据。
+         *
+         * @param sample 原始监控采样，大小为MonitorSampleWords()
+         */
+        virtual void CaptureMonitorSample([[maybe_unused]] uint32_t* sample) const
+        {
+        }
+
+        /**
+         * @brief 根据原始监控采样更新监控数据，该函数在监控线程中调用，只能访问sample和监控数据。
+         *
+         * @param sample 由CaptureMonitorSample拷贝的原始监控采样
+         */
+        virtual void UpdateMonitorData([[maybe_unused]] const uint32_t* sample)
+        {
+        }
+
         /**
          * @brief 默认的上电函数，开发者可以在该函数中实现自己的上电逻辑。
          *
@@ -146,6 +179,38 @@ namespace bitbot
          */
         virtual void get_CAN_IDs(std::vector<size_t>& ids) const = 0;
 
+        /**
+         * @brief 获取设备所连接的EtherCAT转CAN从站的CAN通道
+         * @details 转接板的1、2、3通道对应CAN1，4、5、6通道对应CAN2。未指定通道的设备将按照ID顺序优先分配到CAN1。
+         *
+         * @return size_t 1表示CAN1，2表示CAN2，0表示未指定
+         */
+        virtual size_t get_CAN_Channel() const
+        {
+            return 0;
+        }
+
+        /**
+         * @brief 获取设备的下发优先级，同一CAN通道内优先级越高的设备越先下发。
+         *
+         * @return int 下发优先级，默认为0
+         */
+        virtual int get_CAN_Priority() const
+        {
+            return 0;
+        }
+
+        /**
+         * @brief 获取设备的轮询分频系数，设备每隔该数量的总线周期读写一次。
+         * @details 分频系数大于1的设备将与其他低频设备分时复用转接板通道，可用于挂载超过6个低频设备(如电池)。
+         *
+         * @return size_t 分频系数，默认为1，即每个周期读写一次
+         */
+        virtual size_t get_CAN_RateDivider() const
+        {
+            return 1;
+        }
+
         /**
          * @brief 进行一次读取操作，开发者需要在该函数中实现自己的读取逻辑。该函数会被总线管理器周期性调用。
          *
@@ -170,6 +235,9 @@ namespace bitbot
     /**
      * @brief Encos虚拟总线设备类，继承自EncosDevice, 用户可以使用该类来管理Encos虚拟总线设备。
      * 该类型仅适用于开发者使用，用户无需关心其实现细节。该类型设备是指未挂载在EtherCAT总线上的设备。
+     * @details 虚拟总线设备默认在总线循环中同步调用ReadOnce和WriteOnce。设备节点设置async="1"且设备实现了PollOnce时，
+     * 设备使用异步模式：独立的I/O线程循环调用PollOnce完成系统调用和协议解析，并把采样发布到EncosMailbox中，
+     * 总线循环中的ReadOnce只取走最新的采样，不再产生系统调用。
      *
      */
     class Encos_VirtualBusDevice : public EncosDevice
@@ -186,18 +254,25 @@ namespace bitbot
         Encos_VirtualBusDevice(const pugi::xml_node& device_node)
             : EncosDevice(device_node)
         {
+            ConfigParser::ParseAttribute2b(this->AsyncIO__, device_node.attribute("async"));
+            ConfigParser::ParseAttribute2i(this->AsyncIOCore__, device_node.attribute("async_core"));
         }
 
         /**
          * @brief 析构函数
          * @details 析构函数。设备的生命期由Bitbot Encos内核管理，开发者无需关心设备生命周期。
+         * 使用异步模式的设备必须在自己的析构函数中先调用StopAsyncIO，再释放PollOnce用到的资源。
          *
          */
-        virtual ~Encos_VirtualBusDevice() = default;
+        virtual ~Encos_VirtualBusDevice()
+        {
+            this->StopAsyncIO();
+        }
 
     protected:
         /**
          * @brief 进行一次读取操作，开发者需要在该函数中实现自己的读取逻辑。该函数会被总线管理器周期性调用，但不实际读写总线。
+         * @details 异步模式下该函数只应从邮箱中取走最新的采样。
          *
          */
         virtual void ReadOnce() = 0;
@@ -208,9 +283,87 @@ namespace bitbot
          */
         virtual void WriteOnce() = 0;
 
+        /**
+         * @brief 判断设备是否支持异步模式，实现了PollOnce的设备需要返回true。
+         *
+         * @return true 支持异步模式
+         * @return false 不支持异步模式
+         */
+        virtual bool AsyncIOSupported() const
+        {
+            return false;
+        }
+
+        /**
+         * @brief 异步模式下由设备I/O线程循环调用，开发者在该函数中等待并读取数据，再将采样发布到邮箱中。
+         * @details 该函数可以阻塞等待数据，但每次最多阻塞数毫秒，以便设备析构时I/O线程能够及时退出。
+         *
+         */
+        virtual void PollOnce()
+        {
+        }
+
+        /**
+         * @brief 判断设备是否工作在异步模式
+         *
+         * @return true 异步模式，I/O线程已启动
+         * @return false 同步模式
+         */
+        bool AsyncIOEnabled() const
+        {
+            return this->AsyncIO__;
+        }
+
+        /**
+         * @brief 停止设备I/O线程，可以重复调用。
+         *
+         */
+        void StopAsyncIO()
+        {
+            this->AsyncIORunning__.store(false, std::memory_order_release);
+            if (this->AsyncIOThread__.joinable())
+                this->AsyncIOThread__.join();
+        }
+
         constexpr virtual bool VirtualBusDevice() const final override
         {
             return true;
         }
+
+    private:
+        /**
+         * @brief 按照配置启动设备I/O线程，由总线在初始化时调用。
+         *
+         * @return true 设备工作在异步模式或未要求异步模式
+         * @return false 设备要求异步模式但不支持，退回同步模式
+         */
+        bool StartAsyncIO()
+        {
+            if (!this->AsyncIO__ || this->AsyncIOThread__.joinable())
+                return true;
+            if (!this->AsyncIOSupported())
+            {
+                this->AsyncIO__ = false;
+                return false;
+            }
+            this->AsyncIORunning__.store(true, std::memory_order_release);
+            this->AsyncIOThread__ = std::thread(&Encos_VirtualBusDevice::AsyncIOLoop, this);
+            return true;
+        }
+
+        void AsyncIOLoop()
+        {
+            if (this->AsyncIOCore__ >= 0 && !StickThisThreadToCore(this->AsyncIOCore__))
+                this->logger_->warn("failed to bind the I/O thread of device {} to core {}.", this->id_, this->AsyncIOCore__);
+            while (this->AsyncIORunning__.load(std::memory_order_acquire))
+            {
+                this->PollOnce();
+            }
+        }
+
+        bool AsyncIO__ = false;
+        int AsyncIOCore__ = -1;
+        std::atomic_bool AsyncIORunning__ = false;
+        std::thread AsyncIOThread__;
     };
 };
\ No newline at end of file
@@ -11,6 +11,10 @@
 #include "Encos_device.hpp"
 #include "atomic"
 #include "bus/Encos_bus_msg.h"
+#include "device/Encos_codec.hpp"
+#include "bus/Encos_joint_table.h"
+#include "bus/Encos_rt_logger.h"
+#include "readerwriterqueue.h"
 #include <tuple>
 
 namespace bitbot
@@ -86,6 +90,107 @@ namespace bitbot
         std::atomic<float> Settings_FB_KD;
     };
 
+    /**
+     * @brief 电机故障统计数据
+     * @details 电机每次应答都携带5位错误码。故障在错误码变化时锁存并输出一次日志，持续的同一故障只计数，不重复输出日志。
+     *
+     */
+    struct MotorFaultStatistics
+    {
+        /// @brief 错误码数量(5bit)
+        static constexpr size_t K_CODE_NUM = 32;
+
+        /// @brief 最近一次应答中的错误码，0表示正常。可以在任意线程中读取
+        std::atomic<uint8_t> active_code = 0;
+        /// @brief 自上次清除以来出现过的故障，第k位对应错误码k。可以在任意线程中读取
+        std::atomic<uint32_t> latched = 0;
+        /// @brief 各错误码出现的次数(应答帧数)
+        uint64_t count[K_CODE_NUM] = {};
+        /// @brief 各错误码由无到有的次数
+        uint64_t onset[K_CODE_NUM] = {};
+        /// @brief 各错误码首次出现时的总线周期计数
+        uint64_t first_cycle[K_CODE_NUM] = {};
+        /// @brief 各错误码最近一次出现时的总线周期计数
+        uint64_t last_cycle[K_CODE_NUM] = {};
+    };
+
+    /**
+     * @brief 电机参数设置指令的状态
+     *
+     */
+    enum class EncosConfigStatus : uint8_t
+    {
+        /// @brief 指令队列已满，指令未被接受
+        Rejected = 0,
+        /// @brief 指令在队列中等待下发
+        Pending,
+        /// @brief 指令已下发，等待电机应答
+        Sent,
+        /// @brief 电机应答设置成功
+        Succeeded,
+        /// @brief 电机应答设置失败
+        Failed,
+        /// @brief 超时未收到电机应答
+        TimedOut,
+        /// @brief 状态记录已被之后的指令覆盖，无法查询
+        Expired
+    };
+
+    /**
+     * @brief 电机参数设置指令，由用户线程放入队列，由总线线程取出下发。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     *
+     */
+    struct EncosJointConfigCommand
+    {
+        /// @brief 参数设置代码，1:加速度，2:磁链补偿和扰动补偿，3:反馈KP/KD
+        uint8_t code = 0;
+        /// @brief 参数值
+        float value0 = 0;
+        /// @brief 参数值，仅代码2和3使用
+        float value1 = 0;
+        /// @brief 指令编号
+        uint32_t ticket = 0;
+    };
+
+    class EncosJoint;
+
+    /**
+     * @brief 电机参数设置指令的查询句柄
+     * @details 参数设置指令异步下发，用户可以一次性为所有电机提交指令，之后在每个周期查询句柄直到全部完成，无需手动重试。
+     *
+     */
+    class EncosConfigHandle
+    {
+        friend class EncosJoint;
+
+    public:
+        EncosConfigHandle() = default;
+
+        /**
+         * @brief 查询指令状态，可以在任意线程中调用
+         *
+         * @return EncosConfigStatus 指令状态
+         */
+        EncosConfigStatus Status() const;
+
+        /**
+         * @brief 查询指令是否已结束(成功，失败，超时，被拒绝或无法查询)
+         *
+         * @return true 已结束
+         * @return false 等待下发或等待应答
+         */
+        bool Done() const;
+
+    private:
+        EncosConfigHandle(const EncosJoint* joint, uint32_t ticket)
+            : joint(joint), ticket(ticket)
+        {
+        }
+
+        const EncosJoint* joint = nullptr;
+        uint32_t ticket = 0;
+    };
+
     /**
      * @brief 电机配置数据结构体
      * @details 电机配置数据结构体，包含电机的配置数据，包括电机的转动方向，位置范围，速度范围，力矩范围等。
@@ -136,6 +241,19 @@ namespace bitbot
         /// @brief 电机的电流力矩常数，单位为Nm/A
         const float KT;
 
+        /// @brief 运动模式比例系数的量化参数(12bit)
+        const EncosLinearScale KP_SCALE;
+        /// @brief 运动模式微分系数的量化参数(9bit)
+        const EncosLinearScale KD_SCALE;
+        /// @brief 位置的量化参数(16bit)
+        const EncosLinearScale POS_SCALE;
+        /// @brief 速度的量化参数(12bit)
+        const EncosLinearScale SPD_SCALE;
+        /// @brief 力矩的量化参数(12bit)
+        const EncosLinearScale T_SCALE;
+        /// @brief 电流的量化参数(12bit)
+        const EncosLinearScale I_SCALE;
+
         /**
          * @brief 配置电机的参数
          *
@@ -163,7 +281,13 @@ namespace bitbot
             I_MAX(current_range),
             I_MIN(-current_range),
             MOTOR_DIRECTION(motor_direction),
-            KT(KT)
+            KT(KT),
+            KP_SCALE(EncosLinearScale::Make(0.0f, kp_range, 12)),
+            KD_SCALE(EncosLinearScale::Make(0.0f, kd_range, 9)),
+            POS_SCALE(EncosLinearScale::Make(-pos_range, pos_range, 16)),
+            SPD_SCALE(EncosLinearScale::Make(-vel_range, vel_range, 12)),
+            T_SCALE(EncosLinearScale::Make(-torque_range, torque_range, 12)),
+            I_SCALE(EncosLinearScale::Make(-current_range, current_range, 12))
         {
         }
     };
@@ -184,6 +308,7 @@ namespace bitbot
     class EncosJoint : public Encos_CANBusDevice
     {
         friend class EncosBus;
+        friend class EncosConfigHandle;
 
     public:
         /**
@@ -287,6 +412,35 @@ namespace bitbot
          */
         std::tuple<float, float> GetMotorTemperature();
 
+        /**
+         * @brief 获取电机的故障统计数据，仅可在总线读写所在的线程中调用，独立I/O线程模式下只有active_code和latched可以在其他线程读取。
+         *
+         * @return const MotorFaultStatistics& 故障统计数据
+         */
+        const MotorFaultStatistics& GetFaultStatistics() const;
+
+        /**
+         * @brief 查询电机当前是否处于故障状态
+         *
+         * @return true 最近一次应答中的错误码为故障
+         * @return false 电机正常
+         */
+        bool HasFault() const;
+
+        /**
+         * @brief 清除锁存的故障，计数和周期统计保持不变
+         *
+         */
+        void ClearFaults();
+
+        /**
+         * @brief 获取电机在总线电机状态表中的稠密索引
+         * @details 所有电机按照设备ID从小到大排列，索引从0开始。可以使用该索引访问EncosBus::JointPositions()等批量接口返回的数组。
+         *
+         * @return size_t 电机索引
+         */
+        size_t JointIndex() const;
+
         /**
          * @brief 获取电机的目标位置
          *
@@ -394,18 +548,52 @@ namespace bitbot
          * @param Torque 电机的目标力矩，单位为牛米(Nm)
          */
         void SetTargetMotion(float Position, float Velocity = 0, float Torque = 0);
-        // void HotfixMotorAcceleration(float value);
-        // void HotfixMotorLinkageSpeedKI(float linkage, float KI);
-        // void HotfixMotorFeedbackKP_PD(float Kp, float Kd);
+
+        /**
+         * @brief 设置电机的加速度，该指令进入队列后异步下发。
+         * @details 参数设置指令与控制指令分时下发，每个电机同一时刻只有一条参数设置指令等待应答，收到应答或超时后才下发下一条。
+         * 下发参数设置指令的周期电机不接收控制指令。所有参数设置指令必须在同一个线程中提交。
+         *
+         * @param value 加速度(rad/s^2)，范围0~20
+         * @return EncosConfigHandle 指令查询句柄
+         */
+        EncosConfigHandle HotfixMotorAcceleration(float value);
+
+        /**
+         * @brief 设置电机速度环的磁链观测增益和扰动补偿系数，该指令进入队列后异步下发。
+         *
+         * @param linkage 磁链观测增益，范围0~1
+         * @param KI 扰动补偿系数，范围0~1
+         * @return EncosConfigHandle 指令查询句柄
+         */
+        EncosConfigHandle HotfixMotorLinkageSpeedKI(float linkage, float KI);
+
+        /**
+         * @brief 设置电机位置环的反馈补偿增益和阻尼系数，该指令进入队列后异步下发。
+         *
+         * @param Kp 反馈补偿增益，范围0~1
+         * @param Kd 阻尼系数，范围0~1
+         * @return EncosConfigHandle 指令查询句柄
+         */
+        EncosConfigHandle HotfixMotorFeedbackKP_PD(float Kp, float Kd);
 
         /**
          * @brief 设置电机当前位置为零位
          * @details 设置电机当前位置为零位，该指令会将电机的当前位置设置为零位。
-         * 电机设置零位后会有约500ms的延迟，电机会在此期间停止运动，也会使得电机获取出现停滞。
+         * 下发该指令后电机暂停接收控制指令，直到收到电机的零位设置应答，通常只需要几个总线周期。
+         * 若在配置文件指定的zero_timeout个周期内未收到应答，电机也将恢复接收控制指令。
          * 出于安全考虑，该指令设置后将使得电机的目标位置，目标速度和目标力矩均为0。用户在设置零位后需要重新设置目标位置，速度和力矩。
          */
         void ResetMotorPosition();
 
+        /**
+         * @brief 查询电机是否正在等待零位设置应答
+         *
+         * @return true 零位设置指令已下发，等待电机应答
+         * @return false 未在设置零位
+         */
+        bool isResettingPosition();
+
     private:
         enum class WriteCmdType_e
         {
@@ -416,19 +604,22 @@ namespace bitbot
             POSITION_CONTROL,
             VELOCITY_CONTROL,
             TORQUE_CONTROL,
-            CURRENT_CONTROL,
-            SETTINGS_MOTOR_ACC,
-            SETTINGS_LINK_COMP,
-            SETTINGS_FB_KD
+            CURRENT_CONTROL
         };
         std::atomic<WriteCmdType_e> WriteCmdType__;
 
     private:
         virtual void UpdateRuntimeData() override final;
+        virtual size_t MonitorSampleWords() const override final;
+        virtual void CaptureMonitorSample(uint32_t* sample) const override final;
+        virtual void UpdateMonitorData(const uint32_t* sample) override final;
         virtual void ReadBus(const CAN_Device_Msg& data) override final;
         virtual void WriteBus(CAN_Device_Msg& data) override final;
         virtual size_t get_EtherCAT_Slave_ID() const override final;
         virtual void get_CAN_IDs(std::vector<size_t>& ids) const override final;
+        virtual size_t get_CAN_Channel() const override final;
+        virtual int get_CAN_Priority() const override final;
+        virtual size_t get_CAN_RateDivider() const override final;
 
         virtual bool PowerOn() override;
         virtual bool HasPowerCfg() override;
@@ -437,20 +628,64 @@ namespace bitbot
     private:
         EncosJointMode JointMode__;
         bool Enable__;
-        bool PowerOn__;
+        std::atomic_bool PowerOn__; // set by the control thread, read by the bus loop
         int isConfig__;
+        int ZeroTimeout__; // cycles to wait for the zero point response
+        uint64_t ZeroStartCycle__ = 0;
+        std::atomic<bool> ZeroPending__ = false;
         std::atomic<bool> HighPriorityCommandWriting__;
 
         size_t Slave_ID__;
+        size_t CAN_Channel__;
+        int CAN_Priority__;
+        size_t CAN_RateDivider__;
         static constexpr size_t Alternative_ID__ = 0x7FF;
 
         const MotorConigurationData* ConfigData__;
         MotorRuntimeData RuntimeData__;
 
+        JointStateTable* StateTable__ = nullptr;
+        size_t JointIndex__ = 0;
+
+        MotorFaultStatistics Fault__;
+        const uint64_t* BusCycle__ = nullptr;
+        EncosRtLogger* RtLogger__ = nullptr;
+        EncosRtLogger* ControlLogger__ = nullptr; // used by the interfaces called from the user control thread
+
+        // queued settings commands, submitted by the user thread and sent by the bus thread one at a time
+        static constexpr size_t K_CONFIG_QUEUE_SIZE = 8;
+        static constexpr size_t K_CONFIG_STATUS_NUM = 32; // status records kept for the handles, more than the queue can hold
+        static constexpr uint64_t K_CONFIG_INTERVAL = 10; // cycles between two settings frames
+        static constexpr uint64_t K_CONFIG_TIMEOUT = 200; // cycles to wait for the ack
+        moodycamel::ReaderWriterQueue<EncosJointConfigCommand> ConfigQueue__{ K_CONFIG_QUEUE_SIZE };
+        std::atomic<uint32_t> ConfigStatus__[K_CONFIG_STATUS_NUM] = {}; // ticket << 4 | status
+        uint32_t ConfigTicket__ = 0;
+        EncosJointConfigCommand ConfigInFlight__;
+        uint64_t ConfigDeadline__ = 0;
+        uint64_t ConfigNextSend__ = 0;
+
     private:
+        template <typename... Args>
+        void Log(const EncosLogEvent& event, Args... args)
+        {
+            // before the bus is initialized the message is written directly
+            if (this->RtLogger__ != nullptr) [[likely]]
+                this->RtLogger__->Post(event, args...);
+            else
+                this->logger_->log(event.level, fmt::runtime(event.format), EncosLogArg(args)...);
+        }
+
+        template <typename... Args>
+        void LogControl(const EncosLogEvent& event, Args... args)
+        {
+            if (this->ControlLogger__ != nullptr) [[likely]]
+                this->ControlLogger__->Post(event, args...);
+            else
+                this->logger_->log(event.level, fmt::runtime(event.format), EncosLogArg(args)...);
+        }
+
         void ProcessErrorCode(uint8_t error_code);
-        uint float_to_uint(float x, float x_min, float x_max, int bits);
-        float uint_to_float(uint x_int, float x_min, float x_max, int bits);
+        void StoreState(float position, float velocity, float current, float motor_temp, float driver_temp);
 
         void WriteBusSetMotorMotionControl(CAN_Device_Msg& data);
         void WriteBusSetMotorPositionControl(CAN_Device_Msg& data);
@@ -461,9 +696,14 @@ namespace bitbot
         void WriteBusSetZero(CAN_Device_Msg& data);
         void WriteBusReadCommMode(CAN_Device_Msg& data);
         void WriteBusRead_CAN_ID(CAN_Device_Msg& data);
-        void WriteBusSettingsMotorAcc(CAN_Device_Msg& data);
-        void WriteBusSettingsLinkComp(CAN_Device_Msg& data);
-        void WriteBusSettings_FB_KD(CAN_Device_Msg& data);
+        void WriteBusSettings(CAN_Device_Msg& data, const EncosJointConfigCommand& cmd);
+
+        EncosConfigHandle SubmitConfig(uint8_t code, float value0, float value1);
+        void SetConfigStatus(uint32_t ticket, EncosConfigStatus status);
+        EncosConfigStatus GetConfigStatus(uint32_t ticket) const;
+        bool WriteBusConfig(CAN_Device_Msg& data);
+        void ProcessConfigAck(uint32_t code, bool succeed);
+        uint64_t BusCycle() const;
 
         void ShiftCommand();
     };
@@ -0,0 +1,95 @@
+/**
+ * @file Encos_mailbox.hpp
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos latest-value mailbox header file
+ * @details 线程间传递最新值的邮箱，用于虚拟总线设备的采样和批量电机指令。生产者写入数据，消费者只取走最新的一份，两端都不加锁也不会阻塞。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+#include "atomic"
+#include "cstdint"
+
+namespace bitbot
+{
+    /**
+     * @brief 单生产者单消费者的最新值邮箱(三缓冲)。该类型仅适用于开发者使用，用户无需关心其实现细节。
+     * @details 生产者填充WriteBuffer()后调用Publish()，消费者调用Acquire()取得最新发布的采样。
+     * 两次Acquire之间发布的多份采样只保留最后一份，发布和取得都只交换一次缓冲区下标，不拷贝采样。
+     * WriteBuffer()返回的缓冲区保存的是较早发布过的采样，生产者需要写入完整的采样。
+     *
+     * @tparam T 采样类型
+     */
+    template <typename T>
+    class EncosMailbox
+    {
+    public:
+        /**
+         * @brief 对三个缓冲区逐一调用fn，用于预先分配缓冲区，只能在生产者和消费者开始使用邮箱之前调用
+         *
+         * @param fn 以T&为参数的函数
+         */
+        template <typename Fn>
+        void InitBuffers(Fn&& fn)
+        {
+            for (T& buffer : this->Buffers)
+            {
+                fn(buffer);
+            }
+        }
+
+        /**
+         * @brief 获取生产者当前可写的缓冲区，只能由生产者调用
+         *
+         * @return T& 可写的缓冲区
+         */
+        T& WriteBuffer()
+        {
+            return this->Buffers[this->Back];
+        }
+
+        /**
+         * @brief 发布WriteBuffer()中的采样，只能由生产者调用
+         *
+         */
+        void Publish()
+        {
+            this->Back = this->Middle.exchange(this->Back | K_FRESH, std::memory_order_acq_rel) & K_INDEX;
+            this->Published.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 取得最新发布的采样，只能由消费者调用
+         *
+         * @return const T* 最新的采样，上次调用后没有新的采样时返回nullptr
+         */
+        const T* Acquire()
+        {
+            if ((this->Middle.load(std::memory_order_relaxed) & K_FRESH) == 0)
+                return nullptr;
+            this->Front = this->Middle.exchange(this->Front, std::memory_order_acq_rel) & K_INDEX;
+            return &this->Buffers[this->Front];
+        }
+
+        /**
+         * @brief 获取已发布的采样个数
+         *
+         * @return uint64_t 采样个数
+         */
+        uint64_t PublishedCount() const
+        {
+            return this->Published.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr uint8_t K_INDEX = 0x3;
+        static constexpr uint8_t K_FRESH = 0x4;
+
+        T Buffers[3]{};
+        alignas(64) uint8_t Back = 0; // producer only
+        alignas(64) uint8_t Front = 1; // consumer only
+        alignas(64) std::atomic<uint8_t> Middle = 2;
+        std::atomic<uint64_t> Published = 0;
+    };
+}
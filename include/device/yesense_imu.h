@@ -12,6 +12,8 @@
 #include "atomic"
 #include "yesense_sdk/analysis_data.h"
 #include "Encos_device.hpp"
+#include "Encos_mailbox.hpp"
+#include "bus/Encos_snapshot.h"
 #include <fstream>
 #include <termios.h>
 #include <array>
@@ -57,6 +59,43 @@ namespace bitbot
         std::atomic<float> IMU_temp = 0;
     };
 
+    /**
+     * @brief 一帧IMU数据，单位与ImuRuntimeData一致，用于异步模式下I/O线程向总线循环发布采样。
+     *
+     */
+    struct YesenseImuSample
+    {
+        float roll = 0;
+        float pitch = 0;
+        float yaw = 0;
+        float a_x = 0;
+        float a_y = 0;
+        float a_z = 0;
+        float w_x = 0;
+        float w_y = 0;
+        float w_z = 0;
+        float IMU_temp = 0;
+    };
+
+    /**
+     * @brief IMU串口数据流统计，由读取串口的线程写入
+     *
+     */
+    struct ImuStreamStatistics
+    {
+        /// @brief 解析成功的帧数
+        std::atomic<uint32_t> frames = 0;
+
+        /// @brief 根据帧序号(tid)推算出的丢失帧数
+        std::atomic<uint32_t> dropped_frames = 0;
+
+        /// @brief 校验失败的帧数
+        std::atomic<uint32_t> crc_errors = 0;
+
+        /// @brief 最近两帧的传感器采样时间戳间隔(us)，IMU未输出采样时间戳时为0
+        std::atomic<uint32_t> sample_interval_us = 0;
+    };
+
     /**
      * @brief IMU数据结构体
      *
@@ -65,6 +104,9 @@ namespace bitbot
     {
         /// @brief IMU当前姿态数据
         ImuRuntimeData runtime;
+
+        /// @brief IMU串口数据流统计
+        ImuStreamStatistics stream;
     };
 
     /**
@@ -161,11 +203,27 @@ namespace bitbot
          */
         float GetIMUTemperature();
 
+        /**
+         * @brief 获取IMU的全部状态，单位与各获取函数一致
+         *
+         * @return ImuStateSnapshot IMU状态
+         */
+        ImuStateSnapshot GetState();
+
     private:
         void UpdateRuntimeData() override;
-        void UpdateImuDataFromBus();
+        size_t MonitorSampleWords() const override;
+        void CaptureMonitorSample(uint32_t* sample) const override;
+        void UpdateMonitorData(const uint32_t* sample) override;
+        void DecodeSample(YesenseImuSample& sample) const;
+        void UpdateImuData(const YesenseImuSample& sample);
+        bool ReadSerial();
+        bool ParseFrames();
+        void CountFrame(unsigned short tid);
         void ReadOnce(); // call this function in the bus loop
         void WriteOnce() {};
+        bool AsyncIOSupported() const override;
+        void PollOnce() override; // call this function in the device I/O thread
 
         std::array<float, 3> cvtEuler(const float* quat);
 
@@ -179,13 +237,21 @@ namespace bitbot
 
         int fd;
         int nread;
-        char buffer[RX_BUF_LEN];
         std::string dev;
         struct termios newtio;
         unsigned short cnt = 0;
         int pos = 0;
         speed_t speed = B921600;
 
+        EncosMailbox<YesenseImuSample> Mailbox;
+        constexpr static int K_POLL_TIMEOUT_MS = 10;
+
+        unsigned short LastTid = 0; // 0 before the first frame
+        unsigned int LastSampleTimestamp = 0;
+        constexpr static unsigned int K_TID_MAX = 60000; // tid counts 1 ~ 60000 and wraps
+
+        constexpr static size_t K_IMU_SAMPLE_WORDS = 10; // roll, pitch, yaw, acc xyz, gyro xyz, temperature
+        constexpr static size_t K_MONITOR_SAMPLE_WORDS = K_IMU_SAMPLE_WORDS + 4; // and the stream statistics
         constexpr static float r2d = 180.0f / M_PI;
         constexpr static float d2r = M_PI / 180.0f;
     };
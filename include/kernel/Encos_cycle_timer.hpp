@@ -0,0 +1,242 @@
+/**
+ * @file Encos_cycle_timer.hpp
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos cycle timer header file
+ * @details 内核循环的周期定时器。定时器按照CLOCK_MONOTONIC上的绝对截止时间唤醒，唤醒误差不会累积为相位漂移。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+#include "algorithm"
+#include "array"
+#include "cerrno"
+#include "cstdint"
+#include "string"
+#include "time.h"
+#include "bus/Encos_bus.h"
+
+namespace bitbot
+{
+    /**
+     * @brief 内核循环周期定时器，仅在内核循环线程中使用。
+     * @details 每个周期的截止时间为上一个截止时间加上周期(DC同步模式下再加上DC修正量)，因此循环保持固定的相位。
+     * 开启自旋后，定时器先睡眠到截止时间前spin_ns处，再忙等到截止时间，以减小内核调度带来的唤醒延迟。
+     * 定时器统计每次按时唤醒相对截止时间的误差，每K_JITTER_WINDOW个周期更新一次最小值、最大值和99分位数。
+     * 下一个截止时间在推进时已经过去即为超时，超时后的行为由OverrunPolicy决定。
+     *
+     */
+    class EncosCycleTimer
+    {
+    public:
+        /// @brief 抖动统计窗口(周期)
+        static constexpr uint32_t K_JITTER_WINDOW = 1000;
+
+        /**
+         * @brief 超时策略
+         *
+         */
+        enum class OverrunPolicy
+        {
+            /// @brief 丢弃错过的周期，睡眠到原相位上的下一个截止时间
+            SkipCycle,
+            /// @brief 不睡眠立即开始下一个周期，之后回到原相位
+            SkipSleep,
+            /// @brief 保留所有错过的周期，连续执行直到追上原相位，追赶中的周期不再重复计入已经报告的截止时间
+            CatchUp,
+            /// @brief 不睡眠立即开始下一个周期，并以当前时刻作为新的相位
+            Reanchor
+        };
+
+        /**
+         * @brief 解析超时策略名称
+         *
+         * @param name 策略名称，可选skip_cycle, skip_sleep, catch_up, reanchor
+         * @param policy 解析结果
+         * @return true 解析成功
+         * @return false 未知的策略名称
+         */
+        static bool ParseOverrunPolicy(const std::string& name, OverrunPolicy& policy)
+        {
+            if (name.empty() || name == "skip_cycle")
+                policy = OverrunPolicy::SkipCycle;
+            else if (name == "skip_sleep")
+                policy = OverrunPolicy::SkipSleep;
+            else if (name == "catch_up")
+                policy = OverrunPolicy::CatchUp;
+            else if (name == "reanchor")
+                policy = OverrunPolicy::Reanchor;
+            else
+                return false;
+            return true;
+        }
+
+        /**
+         * @brief 开始计时，第一个截止时间为当前时刻
+         *
+         * @param period_ns 周期(ns)
+         * @param spin_ns 截止时间前自旋等待的时长(ns)，0表示不自旋
+         * @param policy 超时策略
+         */
+        void Start(int64_t period_ns, int64_t spin_ns, OverrunPolicy policy = OverrunPolicy::SkipCycle)
+        {
+            this->Period = period_ns;
+            this->Spin = std::max<int64_t>(spin_ns, 0);
+            this->Policy = policy;
+            this->Deadline = Now();
+            this->WakeTime = this->Deadline;
+            this->Reported = this->Deadline;
+            this->Late = false;
+            this->ResetWindow();
+        }
+
+        /**
+         * @brief 推进到下一个截止时间
+         *
+         * @param correction_ns 本周期的截止时间修正量(ns)，用于DC同步
+         * @return uint64_t 新错过的截止时间个数，0表示按时或者只是在追赶已经报告过的截止时间
+         */
+        uint64_t Advance(int64_t correction_ns = 0)
+        {
+            this->Deadline += this->Period + correction_ns;
+            const int64_t now = Now();
+            this->Late = this->Deadline <= now;
+            if (!this->Late) [[likely]]
+            {
+                this->WakeTime = this->Deadline;
+                return 0;
+            }
+
+            const uint64_t missed = static_cast<uint64_t>((now - this->Deadline) / this->Period) + 1;
+            switch (this->Policy)
+            {
+            case OverrunPolicy::SkipSleep:
+                // stay on the last passed deadline, the next advance lands on the original phase again
+                this->Deadline += static_cast<int64_t>(missed - 1) * this->Period;
+                this->WakeTime = now;
+                break;
+            case OverrunPolicy::CatchUp:
+            {
+                // the deadline stays behind while catching up, only deadlines passed since the last report are new
+                const int64_t last = this->Deadline + static_cast<int64_t>(missed - 1) * this->Period;
+                const uint64_t fresh = this->Reported < this->Deadline ? missed : static_cast<uint64_t>((now - this->Reported) / this->Period);
+                this->Reported = std::max(this->Reported, last);
+                this->WakeTime = this->Deadline;
+                return fresh;
+            }
+            case OverrunPolicy::Reanchor:
+                this->Deadline = now;
+                this->WakeTime = now;
+                break;
+            default:
+                this->Deadline += static_cast<int64_t>(missed) * this->Period;
+                this->WakeTime = this->Deadline;
+                this->Late = false;
+                break;
+            }
+            return missed;
+        }
+
+        /**
+         * @brief 等待到当前唤醒时刻，按时的唤醒会记录唤醒误差
+         *
+         * @return int64_t 唤醒误差(ns)
+         */
+        int64_t Wait()
+        {
+            if (this->Late)
+                return 0;
+
+            SleepUntil(this->WakeTime - this->Spin);
+            int64_t now = Now();
+            while (now < this->WakeTime)
+            {
+                now = Now();
+            }
+
+            const int64_t error = now - this->WakeTime;
+            this->Record(error);
+            return error;
+        }
+
+        /**
+         * @brief 获取上一个完整统计窗口的唤醒抖动
+         *
+         * @return const EncosCycleJitter& 唤醒抖动统计
+         */
+        const EncosCycleJitter& Jitter() const
+        {
+            return this->Result;
+        }
+
+    private:
+        static constexpr size_t K_HISTOGRAM_BINS = 1000; // 1us per bin, the last bin also counts larger errors
+
+        int64_t Period = 0;
+        int64_t Spin = 0;
+        OverrunPolicy Policy = OverrunPolicy::SkipCycle;
+        int64_t Deadline = 0; // CLOCK_MONOTONIC, ns, always on the loop phase
+        int64_t WakeTime = 0; // CLOCK_MONOTONIC, ns
+        int64_t Reported = 0; // CLOCK_MONOTONIC, ns, the last deadline returned as missed in catch up mode
+        bool Late = false; // the next cycle starts without waiting
+
+        uint32_t WindowCount = 0;
+        int64_t WindowMin = 0;
+        int64_t WindowMax = 0;
+        std::array<uint32_t, K_HISTOGRAM_BINS> Histogram{};
+        EncosCycleJitter Result;
+
+        static int64_t Now()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+
+        static void SleepUntil(int64_t time_ns)
+        {
+            struct timespec ts;
+            ts.tv_sec = time_ns / 1000000000;
+            ts.tv_nsec = time_ns % 1000000000;
+            // retry when interrupted by a signal, the deadline is absolute so nothing drifts
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+            {
+            }
+        }
+
+        void ResetWindow()
+        {
+            this->WindowCount = 0;
+            this->WindowMin = INT64_MAX;
+            this->WindowMax = INT64_MIN;
+            this->Histogram.fill(0);
+        }
+
+        void Record(int64_t error)
+        {
+            this->WindowMin = std::min(this->WindowMin, error);
+            this->WindowMax = std::max(this->WindowMax, error);
+            const size_t bin = static_cast<size_t>(std::clamp<int64_t>(error / 1000, 0, K_HISTOGRAM_BINS - 1));
+            this->Histogram[bin]++;
+            if (++this->WindowCount < K_JITTER_WINDOW)
+                return;
+
+            // the first bin whose cumulative count reaches 99% of the window, reported by its upper edge
+            const uint32_t target = (this->WindowCount * 99 + 99) / 100;
+            uint32_t cumulative = 0;
+            size_t p99_bin = 0;
+            for (; p99_bin < K_HISTOGRAM_BINS - 1; p99_bin++)
+            {
+                cumulative += this->Histogram[p99_bin];
+                if (cumulative >= target)
+                    break;
+            }
+
+            this->Result.min_us = static_cast<double>(this->WindowMin) * 1e-3;
+            this->Result.max_us = static_cast<double>(this->WindowMax) * 1e-3;
+            this->Result.p99_us = static_cast<double>(p99_bin + 1);
+            this->Result.windows++;
+            this->ResetWindow();
+        }
+    };
+}
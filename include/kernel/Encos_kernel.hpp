@@ -10,9 +10,17 @@
 #include "bitbot_kernel/kernel/kernel.hpp"
 #include "bus/Encos_bus.h"
 #include "string"
+#include "sstream"
 #include "iostream"
 #include "Joint_AutoZero.hpp"
+#include "Encos_cycle_timer.hpp"
+#include "Encos_rt_thread.hpp"
+#include "Encos_monitor_ring.hpp"
+#include "algorithm"
+#include "atomic"
+#include "thread"
 #include "optional"
+#include "time.h"
 
 namespace bitbot
 {
@@ -61,6 +69,74 @@ namespace bitbot
             ConfigParser::ParseAttribute2i(bus_freq, Encos_node.attribute("BusFrequency"));
             this->run_period = 1e6 / bus_freq;
 
+            bool dc_sync = false;
+            int dc_sync_offset = 0;
+            ConfigParser::ParseAttribute2b(dc_sync, Encos_node.attribute("DCSync"));
+            ConfigParser::ParseAttribute2i(dc_sync_offset, Encos_node.attribute("DCSyncOffset"));
+            this->busmanager_.ConfigureDistributedClock(dc_sync, static_cast<uint32_t>(this->run_period) * 1000, dc_sync_offset * 1000);
+
+            ConfigParser::ParseAttribute2i(this->spin_time, Encos_node.attribute("spin_us"));
+            std::string overrun_policy;
+            ConfigParser::ParseAttribute2s(overrun_policy, Encos_node.attribute("overrun_policy"));
+            if (!EncosCycleTimer::ParseOverrunPolicy(overrun_policy, this->overrun_policy))
+            {
+                this->logger_->error("Invalid overrun_policy {}, check your configuration xml.", overrun_policy);
+                throw std::runtime_error("Invalid overrun_policy");
+            }
+
+            std::string rt_policy;
+            ConfigParser::ParseAttribute2s(rt_policy, Encos_node.attribute("rt_policy"));
+            if (!EncosRtThreadConfig::ParsePolicy(rt_policy, this->rt_thread_config.policy))
+            {
+                this->logger_->error("Invalid rt_policy {}, check your configuration xml.", rt_policy);
+                throw std::runtime_error("Invalid rt_policy");
+            }
+            ConfigParser::ParseAttribute2i(this->rt_thread_config.priority, Encos_node.attribute("rt_priority"));
+            ConfigParser::ParseAttribute2i(this->rt_thread_config.runtime_us, Encos_node.attribute("rt_runtime_us"));
+            ConfigParser::ParseAttribute2i(this->rt_thread_config.core, Encos_node.attribute("rt_core"));
+            ConfigParser::ParseAttribute2b(this->rt_thread_config.lock_memory, Encos_node.attribute("mlock"));
+            ConfigParser::ParseAttribute2i(this->rt_thread_config.prefault_kb, Encos_node.attribute("prefault_kb"));
+
+            ConfigParser::ParseAttribute2b(this->async_monitor, Encos_node.attribute("async_monitor"));
+            ConfigParser::ParseAttribute2i(this->monitor_core, Encos_node.attribute("monitor_core"));
+            if (this->async_monitor && this->monitor_core >= 0 && this->monitor_core == this->rt_thread_config.core)
+            {
+                this->logger_->error("monitor_core {} is also the rt_core, check your configuration xml.", this->monitor_core);
+                throw std::runtime_error("Invalid monitor_core");
+            }
+
+            ConfigParser::ParseAttribute2b(this->io_thread_enable, Encos_node.attribute("io_thread"));
+            ConfigParser::ParseAttribute2i(this->io_core, Encos_node.attribute("io_core"));
+            if (this->io_thread_enable && this->io_core >= 0 && this->io_core == this->rt_thread_config.core)
+            {
+                this->logger_->error("io_core {} is also the rt_core, check your configuration xml.", this->io_core);
+                throw std::runtime_error("Invalid io_core");
+            }
+
+            for (pugi::xml_node group_node = Encos_node.child("group"); group_node != nullptr; group_node = group_node.next_sibling("group"))
+            {
+                uint32_t group_id = 0, divider = 1;
+                std::string slaves_str;
+                ConfigParser::ParseAttribute2ui(group_id, group_node.attribute("id"));
+                ConfigParser::ParseAttribute2ui(divider, group_node.attribute("divider"));
+                ConfigParser::ParseAttribute2s(slaves_str, group_node.attribute("slaves"));
+
+                std::vector<size_t> slaves;
+                std::stringstream slaves_stream(slaves_str);
+                std::string slave;
+                while (std::getline(slaves_stream, slave, ','))
+                {
+                    if (!slave.empty())
+                        slaves.push_back(std::stoul(slave));
+                }
+
+                if (group_id > UINT8_MAX || !this->busmanager_.ConfigureProcessDataGroup(static_cast<uint8_t>(group_id), divider, slaves))
+                {
+                    this->logger_->error("Invalid process data group configuration, check your configuration xml.");
+                    throw std::runtime_error("Invalid process data group configuration");
+                }
+            }
+
             this->is_init = false;
             for (size_t i = 0; i < 5; i++)
             {
@@ -106,7 +182,7 @@ namespace bitbot
                     this->logger_->info("joints power on finished");
                     return static_cast<StateId>(EncosKernelState::POWER_ON_FINISH); }, false);
 #ifdef FUNCTION_AUTO_ZERO
-            this->joint_auto_zero__ = new JointAutoZero(EncosKernel_node.child("zero"), static_cast<double>(1.0 / static_cast<double>(bus_freq)), this->logger_, joints);
+            this->joint_auto_zero__ = new JointAutoZero(EncosKernel_node.child("zero"), static_cast<double>(1.0 / static_cast<double>(bus_freq)), this->logger_, joints, &this->busmanager_.GetRtLogger());
             this->KernelRegisterEvent("start_reset_zero", static_cast<EventId>(EncosKernelEvent::START_RESET_ZERO), [this](EventValue e, UserData &d)
                                       {
                 if (e == static_cast<bitbot::EventValue>(bitbot::KeyboardEvent::Down))
@@ -170,6 +246,8 @@ namespace bitbot
          */
         ~EncosKernel()
         {
+            this->StopIoThread();
+            this->StopMonitorThread();
             if (this->joint_auto_zero__ != nullptr)
                 delete this->joint_auto_zero__;
             std::cout << "\033[32mGood bye from Bitbot Encos. Make Bitbot Everywhere! \033[0m" << std::endl;
@@ -200,6 +278,17 @@ namespace bitbot
                 this->logger_->info("kernel start running");
             }
 
+            // the helper threads are created before this thread becomes real-time, otherwise they inherit the policy and the core of the kernel loop,
+            // and a SCHED_DEADLINE thread can not create threads at all.
+            if (this->async_monitor)
+                this->StartMonitorThread();
+            if (this->io_thread_enable)
+                this->StartIoThread();
+
+            // the kernel loop runs in this thread
+            if (!ApplyRtThreadConfig(this->rt_thread_config, this->run_period, this->logger_))
+                this->logger_->warn("real-time thread configuration is not fully applied.");
+
             std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
             std::chrono::high_resolution_clock::time_point last_time = start_time;
             std::chrono::high_resolution_clock::time_point end_time = start_time;
@@ -208,6 +297,12 @@ namespace bitbot
             constexpr float ms_to_ms = 1 / 1e3;
             constexpr float s_to_ms = 1e3;
 
+            // the loop wakes up at absolute deadlines with a fixed phase, in distributed clock mode the deadlines are corrected by the DC PI controller.
+            // with the EtherCAT I/O thread the bus exchange and the DC correction move to that thread.
+            const bool dc_sync = !this->io_thread_enable && this->busmanager_.DistributedClockEnabled();
+            EncosCycleTimer timer;
+            timer.Start(static_cast<int64_t>(this->run_period) * 1000, static_cast<int64_t>(this->spin_time) * 1000, this->overrun_policy);
+
             while (!this->kernel_config_data_.stop_flag)
             {
                 start_time = std::chrono::high_resolution_clock::now();
@@ -223,29 +318,202 @@ namespace bitbot
                     break;
                 }
                 this->HandleEvents();
-                this->KernelLoopTask();
+                if (this->io_thread_enable)
+                    this->ControlLoopTask();
+                else
+                    this->KernelLoopTask();
 
-                this->KernelPrivateLoopEndTask();
+                if (this->async_monitor)
+                    this->PublishMonitorSample();
+                else
+                    this->KernelPrivateLoopEndTask();
 
                 end_time = std::chrono::high_resolution_clock::now();
 
                 auto time_cost = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
                 this->kernel_runtime_data_.process_time = std::chrono::duration_cast<std::chrono::microseconds>(time_cost).count() * ms_to_ms;
 
-                auto sleep_time = std::chrono::microseconds(this->run_period) - time_cost; //-60为了修正一些误差
-                if (sleep_time > std::chrono::microseconds(0)) [[likely]]
+                const uint64_t missed = timer.Advance(dc_sync ? this->busmanager_.DistributedClockOffset() : 0);
+                this->UpdateOverrunStatistics(time_cost.count(), missed);
+                timer.Wait();
+                if (!this->io_thread_enable)
+                    this->busmanager_.SetCycleJitter(timer.Jitter());
+                this->busmanager_.SetOverrunStatistics(this->overrun_stat);
+            }
+
+            this->StopIoThread();
+            this->StopMonitorThread();
+        }
+
+    private:
+        static constexpr EncosLogEvent K_LOG_TIMEOUT{ spdlog::level::warn, "program time out! period {}, process time {:.3f} ms" };
+        static constexpr EncosLogEvent K_LOG_TIMEOUT_END{ spdlog::level::warn, "program back on time at period {} after {} overrun cycles, {} deadlines missed in total" };
+
+        /**
+         * @brief 更新超时统计，超时只在连续超时开始和结束时各记录一条日志
+         *
+         * @param process_us 本周期的处理时间(us)
+         * @param missed 本周期错过的截止时间个数
+         */
+        void UpdateOverrunStatistics(int64_t process_us, uint64_t missed)
+        {
+            EncosOverrunStatistics& stat = this->overrun_stat;
+            constexpr size_t last_bin = EncosOverrunStatistics::K_PROCESS_BINS - 1;
+            size_t bin = 0;
+            while (bin < last_bin && process_us * 100 > static_cast<int64_t>(EncosOverrunStatistics::K_PROCESS_BIN_PERCENT[bin]) * this->run_period)
+            {
+                bin++;
+            }
+            stat.process_histogram[bin]++;
+            stat.max_process_us = std::max(stat.max_process_us, static_cast<double>(process_us));
+
+            // the first cycles include the start up of the devices and are not reported
+            const bool report = this->kernel_runtime_data_.periods_count > 1000;
+            if (missed == 0) [[likely]]
+            {
+                if (stat.streak != 0 && report)
+                    this->busmanager_.GetRtLogger().Post(K_LOG_TIMEOUT_END, this->kernel_runtime_data_.periods_count, stat.streak, stat.missed_deadlines);
+                stat.streak = 0;
+                return;
+            }
+
+            stat.overruns++;
+            stat.missed_deadlines += missed;
+            stat.streak++;
+            stat.max_streak = std::max(stat.max_streak, stat.streak);
+            if (stat.streak == 1 && report)
+                this->busmanager_.GetRtLogger().Post(K_LOG_TIMEOUT, this->kernel_runtime_data_.periods_count, this->kernel_runtime_data_.process_time);
+        }
+
+        /**
+         * @brief 独立I/O线程模式下的内核循环任务，只执行用户状态回调，总线读写由EtherCAT I/O线程完成。
+         * @details 用户回调与总线之间通过总线已有的邮箱交换数据：状态通过每个电机的原子变量和整机状态快照(见EncosBus::GetStateSnapshot)读取，
+         * 指令通过每个电机的原子变量和批量指令三缓冲区(见EncosBus::SetJointCommands)下发。
+         *
+         */
+        void ControlLoopTask()
+        {
+            this->current_state_->func(this->kernel_interface_, this->extra_data_, this->user_data_);
+        }
+
+        void StartIoThread()
+        {
+            this->io_running.store(true, std::memory_order_release);
+            this->io_thread = std::thread([this]()
+                                          {
+                // the bus exchange is the most timing critical task, it runs one priority above the control thread
+                EncosRtThreadConfig config = this->rt_thread_config;
+                config.core = this->io_core;
+                config.priority = std::min(config.priority + 1, 99);
+                if (!ApplyRtThreadConfig(config, this->run_period, this->logger_, "EtherCAT I/O"))
+                    this->logger_->warn("real-time configuration of the EtherCAT I/O thread is not fully applied.");
+
+                const bool dc_sync = this->busmanager_.DistributedClockEnabled();
+                EncosCycleTimer timer;
+                timer.Start(static_cast<int64_t>(this->run_period) * 1000, static_cast<int64_t>(this->spin_time) * 1000, this->overrun_policy);
+                while (this->io_running.load(std::memory_order_acquire))
                 {
-                    std::this_thread::sleep_for(sleep_time);
-                }
-                else
+                    this->busmanager_.ReadBus();
+                    this->busmanager_.WriteBus();
+                    timer.Advance(dc_sync ? this->busmanager_.DistributedClockOffset() : 0);
+                    timer.Wait();
+                    this->busmanager_.SetCycleJitter(timer.Jitter());
+                } });
+            this->logger_->info("EtherCAT I/O thread started.");
+        }
+
+        void StopIoThread()
+        {
+            this->io_running.store(false, std::memory_order_release);
+            if (this->io_thread.joinable())
+                this->io_thread.join();
+        }
+
+        /**
+         * @brief 在内核循环线程中发布本周期的监控采样，代替KernelPrivateLoopEndTask。
+         * @details 内核循环只拷贝内核运行时数据、设备原始状态、链路统计数据和用户额外数据，
+         * 监控数据的生成、后端推送和CSV记录由监控线程完成。采样缓冲区满时丢弃本周期的采样。
+         *
+         */
+        void PublishMonitorSample()
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            this->kernel_runtime_data_.Update();
+
+            EncosMonitorSample* sample = this->monitor_ring.Acquire();
+            if (sample != nullptr) [[likely]]
+            {
+                const std::vector<Number>& kernel_data = this->kernel_runtime_data_.MonitorData();
+                std::copy(kernel_data.begin(), kernel_data.end(), sample->kernel.begin());
+                this->busmanager_.CaptureMonitorSample(sample->devices.data(), sample->link.data());
+                std::copy(this->extra_data_.begin(), this->extra_data_.end(), sample->extra.begin());
+                sample->record_log = this->kernel_config_data_.record_log_flag;
+                this->monitor_ring.Publish();
+            }
+
+            auto end = std::chrono::high_resolution_clock::now();
+            this->kernel_runtime_data_.kernel_task_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e6;
+        }
+
+        void StartMonitorThread()
+        {
+            this->monitor_ring.Resize(K_MONITOR_RING_SIZE, this->kernel_runtime_data_.MonitorHeader().size(), this->busmanager_.MonitorSampleWords(),
+                                      this->busmanager_.LinkMonitorSize(), this->extra_data_.size());
+            this->monitor_running.store(true, std::memory_order_release);
+            this->monitor_thread = std::thread([this]()
+                                               {
+                // the monitor thread is not real-time, whatever the policy of the thread which starts the kernel
+                sched_param param{};
+                const int rc = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+                if (rc != 0)
+                    this->logger_->warn("failed to set SCHED_OTHER for the monitor thread: {}", std::strerror(rc));
+                if (this->monitor_core >= 0 && !StickThisThreadToCore(this->monitor_core))
+                    this->logger_->warn("failed to bind the monitor thread to core {}.", this->monitor_core);
+
+                uint64_t dropped_reported = 0;
+                while (true)
                 {
-                    if (this->kernel_runtime_data_.periods_count > 1000) [[likely]]
-                        this->logger_->warn("program time out!");
-                }
+                    // read the flag before draining, so that samples published before the stop are not lost
+                    const bool running = this->monitor_running.load(std::memory_order_acquire);
+                    this->DrainMonitorSamples();
+
+                    const uint64_t dropped = this->monitor_ring.DroppedCount();
+                    if (dropped != dropped_reported)
+                    {
+                        this->logger_->warn("{} monitor samples dropped, {} in total.", dropped - dropped_reported, dropped);
+                        dropped_reported = dropped;
+                    }
+                    if (!running)
+                        break;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(K_MONITOR_PERIOD_MS));
+                } });
+            this->logger_->info("monitor thread started.");
+        }
+
+        void StopMonitorThread()
+        {
+            this->monitor_running.store(false, std::memory_order_release);
+            if (this->monitor_thread.joinable())
+                this->monitor_thread.join();
+        }
+
+        void DrainMonitorSamples()
+        {
+            while (const EncosMonitorSample* sample = this->monitor_ring.Front())
+            {
+                this->monitor_data_.clear();
+                this->monitor_data_.insert(this->monitor_data_.end(), sample->kernel.begin(), sample->kernel.end());
+                this->busmanager_.UpdateMonitorData(sample->devices.data(), sample->link.data(), this->monitor_data_);
+                this->monitor_data_.insert(this->monitor_data_.end(), sample->extra.begin(), sample->extra.end());
+                const bool record_log = sample->record_log;
+                this->monitor_ring.Pop();
+
+                this->backend_->SetMonitorData(this->monitor_data_);
+                if (record_log)
+                    this->runtime_data_logger_->Write(this->monitor_data_);
             }
         }
 
-    private:
         void PrintWelcomeMessage()
         {
             std::string line0 = "\033[32m================================================================================== \033[0m";
@@ -272,6 +540,23 @@ namespace bitbot
     private:
         bool is_init;
         int run_period; // run period in micro second
+        int spin_time = 0; // busy wait before each deadline in micro second
+        EncosCycleTimer::OverrunPolicy overrun_policy = EncosCycleTimer::OverrunPolicy::SkipCycle;
+        EncosOverrunStatistics overrun_stat; // updated by the kernel loop, published in the bus monitor
+
+        static constexpr size_t K_MONITOR_RING_SIZE = 256; // cycles buffered between the kernel loop and the monitor thread
+        static constexpr int K_MONITOR_PERIOD_MS = 2;
+        bool async_monitor = false; // generate monitor data in the monitor thread
+        int monitor_core = -1;
+        EncosMonitorRing monitor_ring;
+        std::atomic_bool monitor_running = false;
+        std::thread monitor_thread;
+
+        bool io_thread_enable = false; // run ReadBus and WriteBus in a dedicated EtherCAT I/O thread
+        int io_core = -1;
+        std::atomic_bool io_running = false;
+        std::thread io_thread;
+        EncosRtThreadConfig rt_thread_config; // applied to the kernel loop thread
 
         JointAutoZero *joint_auto_zero__ = nullptr; // joint auto zero class
     };
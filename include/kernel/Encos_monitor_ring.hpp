@@ -0,0 +1,131 @@
+/**
+ * @file Encos_monitor_ring.hpp
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos monitor sample ring header file
+ * @details 内核循环每个周期发布的监控采样环形缓冲区。内核循环只拷贝原始数据，监控数据的生成、后端推送和CSV记录由监控线程完成。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+#include "atomic"
+#include "cstdint"
+#include "vector"
+#include "bitbot_kernel/types.hpp"
+
+namespace bitbot
+{
+    /**
+     * @brief 一个周期的监控采样，所有缓冲区在启动前分配，内核循环中只拷贝数据。
+     *
+     */
+    struct EncosMonitorSample
+    {
+        /// @brief 内核运行时数据
+        std::vector<Number> kernel;
+        /// @brief 各设备的原始监控采样，按总线设备顺序排列，见EncosDevice::CaptureMonitorSample
+        std::vector<uint32_t> devices;
+        /// @brief 总线链路统计数据
+        std::vector<Number> link;
+        /// @brief 用户额外数据
+        std::vector<Number> extra;
+        /// @brief 该周期是否需要写入CSV记录
+        bool record_log = false;
+    };
+
+    /**
+     * @brief 单生产者单消费者的监控采样环形缓冲区，生产者为内核循环线程，消费者为监控线程。
+     * @details 生产者通过Acquire取得一个空闲采样，填充后调用Publish发布；缓冲区满时Acquire返回nullptr，该周期的采样被丢弃并计数。
+     * 消费者通过Front取得最早的采样，处理后调用Pop释放。
+     *
+     */
+    class EncosMonitorRing
+    {
+    public:
+        /**
+         * @brief 分配缓冲区，只能在没有生产者和消费者时调用
+         *
+         * @param capacity 采样个数
+         * @param kernel 内核运行时数据个数
+         * @param devices 设备原始采样大小(32位字)
+         * @param link 总线链路统计数据个数
+         * @param extra 用户额外数据个数
+         */
+        void Resize(size_t capacity, size_t kernel, size_t devices, size_t link, size_t extra)
+        {
+            this->Samples.resize(capacity);
+            for (auto& sample : this->Samples)
+            {
+                sample.kernel.resize(kernel);
+                sample.devices.resize(devices);
+                sample.link.resize(link);
+                sample.extra.resize(extra);
+            }
+            this->Head.store(0, std::memory_order_relaxed);
+            this->Tail.store(0, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 取得一个空闲采样，只能由生产者调用
+         *
+         * @return EncosMonitorSample* 空闲采样，缓冲区满时返回nullptr
+         */
+        EncosMonitorSample* Acquire()
+        {
+            const uint64_t head = this->Head.load(std::memory_order_relaxed);
+            if (head - this->Tail.load(std::memory_order_acquire) >= this->Samples.size()) [[unlikely]]
+            {
+                this->Dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            return &this->Samples[head % this->Samples.size()];
+        }
+
+        /**
+         * @brief 发布由Acquire取得的采样，只能由生产者调用
+         *
+         */
+        void Publish()
+        {
+            this->Head.store(this->Head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 取得最早发布的采样，只能由消费者调用
+         *
+         * @return const EncosMonitorSample* 采样，缓冲区为空时返回nullptr
+         */
+        const EncosMonitorSample* Front() const
+        {
+            const uint64_t tail = this->Tail.load(std::memory_order_relaxed);
+            if (tail == this->Head.load(std::memory_order_acquire))
+                return nullptr;
+            return &this->Samples[tail % this->Samples.size()];
+        }
+
+        /**
+         * @brief 释放由Front取得的采样，只能由消费者调用
+         *
+         */
+        void Pop()
+        {
+            this->Tail.store(this->Tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 获取因缓冲区已满而丢弃的采样个数
+         *
+         * @return uint64_t 丢弃的采样个数
+         */
+        uint64_t DroppedCount() const
+        {
+            return this->Dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::vector<EncosMonitorSample> Samples;
+        alignas(64) std::atomic<uint64_t> Head = 0;
+        alignas(64) std::atomic<uint64_t> Tail = 0;
+        std::atomic<uint64_t> Dropped = 0;
+    };
+}
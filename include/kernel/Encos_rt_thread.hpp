@@ -0,0 +1,231 @@
+/**
+ * @file Encos_rt_thread.hpp
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos real-time thread provisioning header file
+ * @details 内核循环线程的实时配置，包括调度策略、优先级、CPU亲和性、内存锁定和内存预缺页。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+#include "cerrno"
+#include "cstdlib"
+#include "cstring"
+#include "string"
+#include "alloca.h"
+#include "malloc.h"
+#include "pthread.h"
+#include "sched.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "bitbot_kernel/utils/cpu_affinity.h"
+#include "bitbot_kernel/utils/priority.h"
+#include "bitbot_kernel/utils/logger.h"
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+namespace bitbot
+{
+    /**
+     * @brief 内核循环线程的实时配置，由<Encos>节点的属性解析得到。
+     *
+     */
+    struct EncosRtThreadConfig
+    {
+        /// @brief 调度策略
+        enum class Policy
+        {
+            /// @brief 不修改调度策略
+            None,
+            /// @brief SCHED_FIFO
+            Fifo,
+            /// @brief SCHED_RR
+            RoundRobin,
+            /// @brief SCHED_DEADLINE，运行时间预算为runtime_us，周期和截止时间为内核周期
+            Deadline
+        };
+
+        /// @brief 调度策略
+        Policy policy = Policy::None;
+        /// @brief FIFO/RR策略下的优先级(1~99)
+        int priority = 80;
+        /// @brief DEADLINE策略下每个周期的运行时间预算(us)，0表示内核周期的80%
+        int runtime_us = 0;
+        /// @brief 绑定的CPU核心，-1表示不绑定
+        int core = -1;
+        /// @brief 是否使用mlockall锁定当前和将来的全部内存
+        bool lock_memory = false;
+        /// @brief 预缺页的栈和堆大小(KiB)，0表示不预缺页
+        int prefault_kb = 0;
+
+        /**
+         * @brief 解析调度策略名称
+         *
+         * @param name 策略名称，可选none, fifo, rr, deadline
+         * @param policy 解析结果
+         * @return true 解析成功
+         * @return false 未知的策略名称
+         */
+        static bool ParsePolicy(const std::string& name, Policy& policy)
+        {
+            if (name.empty() || name == "none")
+                policy = Policy::None;
+            else if (name == "fifo")
+                policy = Policy::Fifo;
+            else if (name == "rr")
+                policy = Policy::RoundRobin;
+            else if (name == "deadline")
+                policy = Policy::Deadline;
+            else
+                return false;
+            return true;
+        }
+    };
+
+    /**
+     * @brief 预缺页当前线程的栈，不能内联，否则栈空间要到调用者返回时才会释放。
+     *
+     * @param bytes 预缺页大小(byte)
+     * @param page 页大小(byte)
+     */
+    [[gnu::noinline]] inline void PrefaultStack(size_t bytes, size_t page)
+    {
+        volatile char* stack = static_cast<volatile char*>(alloca(bytes));
+        for (size_t i = 0; i < bytes; i += page)
+        {
+            stack[i] = 0;
+        }
+    }
+
+    /**
+     * @brief 将实时配置应用到当前线程，并回读实际生效的配置写入日志。
+     * @details 需要在内核循环线程中、进入循环之前调用。任何一项配置失败都只记录警告，内核仍然继续运行。
+     * 由于SCHED_DEADLINE要求线程可以在整个调度域上运行，DEADLINE策略下不绑定CPU核心。
+     *
+     * @param config 实时配置
+     * @param period_us 内核周期(us)
+     * @param logger 日志记录器
+     * @param name 线程名称，用于日志
+     * @return true 全部配置均已生效
+     * @return false 至少有一项配置未生效
+     */
+    inline bool ApplyRtThreadConfig(const EncosRtThreadConfig& config, int period_us, SpdLoggerSharedPtr logger, const char* name = "kernel")
+    {
+        using Policy = EncosRtThreadConfig::Policy;
+        bool ok = true;
+        bool memory_locked = false;
+
+        // memory first, so that the pages touched below stay resident
+        if (config.lock_memory)
+        {
+            memory_locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+            if (!memory_locked)
+            {
+                logger->warn("mlockall failed: {}", std::strerror(errno));
+                ok = false;
+            }
+        }
+
+        if (config.prefault_kb > 0)
+        {
+            const size_t bytes = static_cast<size_t>(config.prefault_kb) * 1024;
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+            // keep freed memory in the heap instead of returning it to the system
+            mallopt(M_TRIM_THRESHOLD, -1);
+            mallopt(M_MMAP_MAX, 0);
+            if (char* heap = static_cast<char*>(std::malloc(bytes)))
+            {
+                for (size_t i = 0; i < bytes; i += page)
+                {
+                    static_cast<volatile char*>(heap)[i] = 0;
+                }
+                std::free(heap);
+            }
+
+            PrefaultStack(bytes, page);
+        }
+
+        if (config.core >= 0)
+        {
+            if (config.policy == Policy::Deadline)
+            {
+                logger->warn("rt_core is ignored with the deadline policy.");
+                ok = false;
+            }
+            else if (!StickThisThreadToCore(config.core))
+            {
+                logger->warn("failed to bind the {} thread to core {}.", name, config.core);
+                ok = false;
+            }
+        }
+
+        switch (config.policy)
+        {
+        case Policy::Fifo:
+        {
+            sched_param param{};
+            param.sched_priority = config.priority;
+            const int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (rc != 0)
+            {
+                logger->warn("failed to set SCHED_FIFO priority {}: {}", config.priority, std::strerror(rc));
+                ok = false;
+            }
+            break;
+        }
+        case Policy::RoundRobin:
+            if (!setProcessHighPriority(static_cast<unsigned int>(config.priority)))
+            {
+                logger->warn("failed to set SCHED_RR priority {}.", config.priority);
+                ok = false;
+            }
+            break;
+        case Policy::Deadline:
+        {
+            const unsigned int period_ns = static_cast<unsigned int>(period_us) * 1000;
+            const unsigned int runtime_ns = config.runtime_us > 0 ? static_cast<unsigned int>(config.runtime_us) * 1000 : period_ns / 5 * 4;
+            if (!SetDeadlinePolicy(runtime_ns, period_ns, period_ns))
+            {
+                logger->warn("failed to set SCHED_DEADLINE runtime {} ns, period {} ns.", runtime_ns, period_ns);
+                ok = false;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        // report what actually took effect
+        const int policy = sched_getscheduler(0);
+        sched_param param{};
+        sched_getparam(0, &param);
+        const char* policy_name = policy == SCHED_FIFO       ? "fifo"
+                                  : policy == SCHED_RR       ? "rr"
+                                  : policy == SCHED_DEADLINE ? "deadline"
+                                                             : "other";
+
+        std::string cores;
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0)
+        {
+            for (int i = 0; i < CPU_SETSIZE; i++)
+            {
+                if (CPU_ISSET(i, &cpuset))
+                    cores += (cores.empty() ? "" : ",") + std::to_string(i);
+            }
+        }
+        if (config.core >= 0 && config.policy != Policy::Deadline && (CPU_COUNT(&cpuset) != 1 || !CPU_ISSET(config.core, &cpuset)))
+            ok = false;
+        constexpr int expected_policy[] = { -1, SCHED_FIFO, SCHED_RR, SCHED_DEADLINE };
+        if (config.policy != Policy::None && policy != expected_policy[static_cast<int>(config.policy)])
+            ok = false;
+
+        logger->info("{} thread: policy {}, priority {}, cores [{}], memory locked {}, prefault {} KiB.",
+                     name, policy_name, param.sched_priority, cores, memory_locked, config.prefault_kb);
+        return ok;
+    }
+}
@@ -11,6 +11,7 @@
 #include "bus/Encos_bus.h"
 #include "device/Encos_joint.h"
 #include "bitbot_kernel/utils/logger.h"
+#include "bus/Encos_rt_logger.h"
 
 namespace bitbot
 {
@@ -47,10 +48,12 @@ namespace bitbot
          * @param period 内核运行周期时间
          * @param logger 日志记录器指针
          * @param joints 电机列表，包含所有的电机
+         * @param rt_logger 内核循环中使用的实时日志，为nullptr时直接写入logger
          */
-        JointAutoZero(const pugi::xml_node &reset_node, double period, SpdLoggerSharedPtr logger, std::vector<EncosJoint *> &joints)
+        JointAutoZero(const pugi::xml_node &reset_node, double period, SpdLoggerSharedPtr logger, std::vector<EncosJoint *> &joints, EncosRtLogger *rt_logger = nullptr)
         {
             this->logger__ = logger;
+            this->rt_logger__ = rt_logger;
             this->current_state__ = JointResetStates::Waiting;
 
             pugi::xml_node reset_group_node = reset_node.child("resetter");
@@ -107,7 +110,7 @@ namespace bitbot
                 this->current_state__ = JointResetStates::ApplyingTorque;
                 this->current_group_index__ = 0;
                 this->next_state_period_count__ = period_count + reset_period_count__[current_group_index__];
-                this->logger__->info("\n\nJointAutoZero: Applying constant torque in joint 0");
+                this->Log(K_LOG_APPLY_TORQUE, 0);
                 for (auto joint : joints__)
                 {
                     joint->SetMode(EncosJointMode::Torque);
@@ -131,18 +134,18 @@ namespace bitbot
         {
             if (current_state__ == JointResetStates::Waiting || this->current_state__ == JointResetStates::Finished)
             {
-                this->logger__->info("JointAutoZero: reset not start or finished");
+                this->Log(K_LOG_NOT_STARTED);
                 return false;
             }
             else if (current_state__ == JointResetStates::Stopped)
             {
-                this->logger__->info("JointAutoZero: reset already stopped");
+                this->Log(K_LOG_ALREADY_STOPPED);
                 return false;
             }
             else
             {
                 this->current_state__ = JointResetStates::Stopped;
-                this->logger__->info("JointAutoZero: reset stopped!!!");
+                this->Log(K_LOG_STOPPED);
                 for (auto joint : joints__)
                 {
                     joint->SetMode(EncosJointMode::Torque);
@@ -175,9 +178,7 @@ namespace bitbot
                         joint->SetTargetTorque(0);
                     }
 
-                    std::string info = "JointAutoZero: resetting zero for joint ";
-                    info += std::to_string(current_group_index__);
-                    this->logger__->info(info);
+                    this->Log(K_LOG_RESETTING, current_group_index__);
                 }
                 break;
             case JointResetStates::Resetting:
@@ -187,7 +188,7 @@ namespace bitbot
                     if (this->current_group_index__ == joint_groups__.size() - 1)
                     {
                         this->current_state__ = JointResetStates::Finished;
-                        this->logger__->info("JointAutoZero: resetting zero finished");
+                        this->Log(K_LOG_FINISHED);
                     }
                     else
                     {
@@ -195,9 +196,7 @@ namespace bitbot
                         this->current_group_index__++;
                         this->next_state_period_count__ = period_count + reset_period_count__[current_group_index__];
 
-                        std::string info = "\n\nJointAutoZero: Applying constant torque in joint ";
-                        info += std::to_string(current_group_index__);
-                        this->logger__->info(info);
+                        this->Log(K_LOG_APPLY_TORQUE, current_group_index__);
                     }
 
                     // for (auto joint : joints__)
@@ -231,6 +230,24 @@ namespace bitbot
         }
 
     private:
+        // state transitions happen in the kernel loop, they are logged through the real-time logger of the bus
+        static constexpr EncosLogEvent K_LOG_APPLY_TORQUE{ spdlog::level::info, "\n\nJointAutoZero: Applying constant torque in joint {}" };
+        static constexpr EncosLogEvent K_LOG_RESETTING{ spdlog::level::info, "JointAutoZero: resetting zero for joint {}" };
+        static constexpr EncosLogEvent K_LOG_FINISHED{ spdlog::level::info, "JointAutoZero: resetting zero finished" };
+        static constexpr EncosLogEvent K_LOG_NOT_STARTED{ spdlog::level::info, "JointAutoZero: reset not start or finished" };
+        static constexpr EncosLogEvent K_LOG_ALREADY_STOPPED{ spdlog::level::info, "JointAutoZero: reset already stopped" };
+        static constexpr EncosLogEvent K_LOG_STOPPED{ spdlog::level::info, "JointAutoZero: reset stopped!!!" };
+        static constexpr EncosLogEvent K_LOG_ZERO_ERROR{ spdlog::level::info, "JointAutoZero: joint {} zero point error= {}" };
+
+        template <typename... Args>
+        void Log(const EncosLogEvent &event, Args... args)
+        {
+            if (this->rt_logger__ != nullptr)
+                this->rt_logger__->Post(event, args...);
+            else
+                this->logger__->log(event.level, fmt::runtime(event.format), EncosLogArg(args)...);
+        }
+
         void StateApplyTorque()
         {
             for (size_t i = 0; i < joint_groups__[current_group_index__].size(); i++)
@@ -245,7 +262,7 @@ namespace bitbot
         {
             for (size_t i = 0; i < joint_groups__[current_group_index__].size(); i++)
             {
-                this->logger__->info("JointAutoZero: joint {} zero point error= {}", joint_groups__[current_group_index__][i]->Name(), joint_groups__[current_group_index__][i]->GetActualPosition() * this->r2d);
+                this->Log(K_LOG_ZERO_ERROR, joint_groups__[current_group_index__][i]->Id(), joint_groups__[current_group_index__][i]->GetActualPosition() * this->r2d);
                 joint_groups__[current_group_index__][i]->ResetMotorPosition();
             }
         }
@@ -295,6 +312,7 @@ namespace bitbot
 
     private:
         SpdLoggerSharedPtr logger__;
+        EncosRtLogger *rt_logger__ = nullptr;
 
         std::vector<EncosJoint *> joints__;
 
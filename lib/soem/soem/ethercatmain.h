@@ -23,8 +23,8 @@ extern "C"
 #define EC_MAXNAME        40
 /** max. number of slaves in array */
 #define EC_MAXSLAVE       200
-/** max. number of groups */
-#define EC_MAXGROUP       2
+/** max. number of groups, group 0 maps all slaves so Bitbot Encos needs one more than its process data groups */
+#define EC_MAXGROUP       3
 /** max. number of IO segments per group */
 #define EC_MAXIOSEGMENTS  64
 /** max. mailbox size */
@@ -1,5 +1,10 @@
 ﻿#include "bus/Encos_bus.h"
+#include "device/Encos_joint.h"
+#include "device/yesense_imu.h"
 #include "algorithm"
+#include "numeric"
+#include "cstring"
+#include "cmath"
 #include "iostream"
 #include "ethercat.h"
 
@@ -12,7 +17,15 @@ namespace bitbot
     {
     }
 
-    EncosBus::~EncosBus() {}
+    EncosBus::~EncosBus()
+    {
+        this->StopSupervisor();
+        // devices are deleted by the bus manager, their I/O threads must stop first
+        for (auto dev : this->VirtualBusDevices)
+        {
+            dev->StopAsyncIO();
+        }
+    }
 
     void EncosBus::RegisterDevices()
     {
@@ -86,6 +99,9 @@ namespace bitbot
 
     void EncosBus::Init()
     {
+        this->RtLogger.Start(this->logger_);
+        this->ControlRtLogger.Start(this->logger_);
+
         this->CAN_Device_By_EtherCAT_ID.resize(ec_slavecount);
         this->CAN_BusReadBuffer.resize(ec_slavecount);
         this->CAN_BusWriteBuffer.resize(ec_slavecount);
@@ -133,22 +149,17 @@ namespace bitbot
                 {
                     this->logger_->error("Unknown device type, check your configuration xml.");
                     this->ErrorFlag.store(true);
+                    continue;
                 }
 
-                std::vector<size_t> CAN_IDs;
-                CanDev->get_CAN_IDs(CAN_IDs);
                 size_t SlaveID = CanDev->get_EtherCAT_Slave_ID();
-                this->CAN_Device_By_EtherCAT_ID[SlaveID].push_back(CanDev);
-
-                for (size_t i = 0; i < CAN_IDs.size(); i++)
+                if (SlaveID >= this->CAN_Device_By_EtherCAT_ID.size())
                 {
-
-                    if (this->CAN_Device_By_CAN_ID.count(CAN_IDs[i]) == 0)
-                    {
-                        this->CAN_Device_By_CAN_ID.insert({ CAN_IDs[i], std::vector<Encos_CANBusDevice*>() });
-                    }
-                    this->CAN_Device_By_CAN_ID[CAN_IDs[i]].push_back(CanDev);
+                    this->logger_->error("Device {} is attached to EtherCAT slave {}, but only {} slaves found, check your configuration xml.", CanDev->Id(), SlaveID, this->CAN_Device_By_EtherCAT_ID.size());
+                    this->ErrorFlag.store(true);
+                    continue;
                 }
+                this->CAN_Device_By_EtherCAT_ID[SlaveID].push_back(CanDev);
             }
         }
 
@@ -156,13 +167,254 @@ namespace bitbot
         {
             std::sort(this->CAN_Device_By_EtherCAT_ID[i].begin(), this->CAN_Device_By_EtherCAT_ID[i].end(), [](Encos_CANBusDevice* a, Encos_CANBusDevice* b)
                 { return a->Id() < b->Id(); });
+        }
+
+        this->BuildRouteTable();
 
-            if (this->CAN_Device_By_EtherCAT_ID[i].size() > 6)
+        // dense joint index in device id order, the state table is written by the bus loop
+        this->Joints.clear();
+        for (auto dev : this->devices_)
+        {
+            if (EncosJoint* joint = dynamic_cast<EncosJoint*>(dev))
+                this->Joints.push_back(joint);
+        }
+        std::sort(this->Joints.begin(), this->Joints.end(), [](EncosJoint* a, EncosJoint* b)
+            { return a->Id() < b->Id(); });
+        this->JointStates.Resize(this->Joints.size());
+        for (size_t i = 0; i < this->Joints.size(); i++)
+        {
+            this->Joints[i]->JointIndex__ = i;
+            this->Joints[i]->StateTable__ = &this->JointStates;
+            this->Joints[i]->BusCycle__ = &this->cycle_cnt;
+            this->Joints[i]->RtLogger__ = &this->RtLogger;
+            this->Joints[i]->ControlLogger__ = &this->ControlRtLogger;
+        }
+
+        for (auto table : { &this->JointCommandStaging, &this->JointCommandMin, &this->JointCommandMax })
+        {
+            table->Resize(this->Joints.size());
+        }
+        const size_t joint_num = this->Joints.size();
+        this->JointCommandMailbox.InitBuffers([joint_num](JointCommandTable& table) { table.Resize(joint_num); });
+        for (size_t i = 0; i < this->Joints.size(); i++)
+        {
+            const MotorConigurationData* cfg = this->Joints[i]->ConfigData__;
+            this->JointCommandMin.position[i] = cfg->POS_MIN;
+            this->JointCommandMax.position[i] = cfg->POS_MAX;
+            this->JointCommandMin.velocity[i] = cfg->SPD_MIN;
+            this->JointCommandMax.velocity[i] = cfg->SPD_MAX;
+            this->JointCommandMin.torque[i] = cfg->T_MIN;
+            this->JointCommandMax.torque[i] = cfg->T_MAX;
+            this->JointCommandMin.kp[i] = cfg->KP_MIN;
+            this->JointCommandMax.kp[i] = cfg->KP_MAX;
+            this->JointCommandMin.kd[i] = cfg->KD_MIN;
+            this->JointCommandMax.kd[i] = cfg->KD_MAX;
+        }
+
+        this->Imus.clear();
+        for (auto dev : this->VirtualBusDevices)
+        {
+            if (YesenseIMU* imu = dynamic_cast<YesenseIMU*>(dev))
+                this->Imus.push_back(imu);
+        }
+        std::sort(this->Imus.begin(), this->Imus.end(), [](YesenseIMU* a, YesenseIMU* b)
+            { return a->Id() < b->Id(); });
+        this->StateSnapshot.Resize(2 + this->Joints.size() * 6 + this->Imus.size() * K_IMU_SNAPSHOT_WORDS);
+
+        // link statistics are published next to the device data
+        this->LinkStatistics = EtherCAT_LinkStatistics();
+        this->LinkStatistics.expected_wkc = this->expectedWKC;
+        const size_t slave_count = static_cast<size_t>(ec_slavecount);
+        this->SlaveInputsStaleSince.assign(slave_count, 0);
+        this->SlaveFault = std::make_unique<std::atomic_bool[]>(slave_count);
+        for (size_t i = 0; i < slave_count; i++)
+        {
+            this->SlaveFault[i].store(false);
+        }
+
+        DeviceMonitorHeader link_header;
+        link_header.name = "ethercat";
+        link_header.type = "EncosBus";
+        link_header.headers = { "wkc", "expected_wkc", "lost_frames", "short_wkc", "miss_streak", "max_miss_streak", "rt_log_dropped", "wakeup_min_us", "wakeup_max_us", "wakeup_p99_us",
+                               "overruns", "missed_deadlines", "max_overrun_streak", "process_max_us" };
+        for (size_t i = 0; i < EncosOverrunStatistics::K_PROCESS_BINS - 1; i++)
+        {
+            link_header.headers.push_back("process_le" + std::to_string(EncosOverrunStatistics::K_PROCESS_BIN_PERCENT[i]) + "pct");
+        }
+        link_header.headers.push_back("process_gt100pct");
+        for (size_t i = 0; i < slave_count; i++)
+        {
+            link_header.headers.push_back("slave" + std::to_string(i) + "_stale_since");
+        }
+        for (auto& header : link_header.headers)
+        {
+            this->devices_csv_headers_.push_back(link_header.name + "_" + header);
+        }
+        this->bus_monitor_header_.devices.push_back(link_header);
+        this->LinkMonitorData.resize(link_header.headers.size());
+
+        constexpr size_t word = sizeof(uint32_t);
+        this->LinkSnapshot.Resize((sizeof(EtherCAT_LinkStatistics) + sizeof(EncosCycleJitter) + sizeof(uint64_t) * slave_count) / word);
+        this->LinkSnapshotWords.resize(this->LinkSnapshot.Size());
+        this->PublishLinkSnapshot();
+
+        for (auto dev : this->VirtualBusDevices)
+        {
+            if (!dev->StartAsyncIO())
+                this->logger_->warn("device {} does not support async mode, it is read in the bus loop.", dev->Name());
+            else if (dev->AsyncIOEnabled())
+                this->logger_->info("device {} is read by its own I/O thread.", dev->Name());
+        }
+
+        this->StartSupervisor();
+    }
+
+    void EncosBus::BuildRouteTable()
+    {
+        const size_t slave_count = this->CAN_Device_By_EtherCAT_ID.size();
+        this->CAN_WriteRoute.clear();
+        this->CAN_SlotSpan.clear();
+        this->CAN_WriteSpan.assign(slave_count, CAN_RouteSpan());
+        this->CAN_ReadRoute.clear();
+        this->CAN_ReadJoint.clear();
+        this->CAN_ReadSpan.assign(slave_count * K_CAN_ID_SPACE, CAN_RouteSpan());
+
+        std::vector<size_t> CAN_IDs;
+        std::vector<std::vector<CAN_SlotEntry>> slots;
+        for (size_t i = 0; i < slave_count; i++)
+        {
+            if (!this->AllocateSlots(i, slots))
             {
-                this->logger_->error("CAN devices for each EtherCAT salves can not be greater than 6, check your configuration xml.");
                 this->ErrorFlag.store(true);
+                slots.clear();
+            }
+
+            this->CAN_WriteSpan[i].offset = static_cast<uint16_t>(this->CAN_SlotSpan.size());
+            this->CAN_WriteSpan[i].count = static_cast<uint16_t>(slots.size());
+            for (auto&& slot : slots)
+            {
+                CAN_RouteSpan slot_span;
+                slot_span.offset = static_cast<uint16_t>(this->CAN_WriteRoute.size());
+                slot_span.count = static_cast<uint16_t>(slot.size());
+                this->CAN_SlotSpan.push_back(slot_span);
+                this->CAN_WriteRoute.insert(this->CAN_WriteRoute.end(), slot.begin(), slot.end());
+            }
+
+            // group the devices of this slave by CAN id, then lay every group out contiguously.
+            std::map<size_t, std::vector<Encos_CANBusDevice*>> devices_by_id;
+            for (auto dev : this->CAN_Device_By_EtherCAT_ID[i])
+            {
+                dev->get_CAN_IDs(CAN_IDs);
+                for (auto id : CAN_IDs)
+                {
+                    if (id >= K_CAN_ID_SPACE)
+                    {
+                        this->logger_->error("Device {} uses CAN id {}, only 11-bit standard CAN id is supported.", dev->Id(), id);
+                        this->ErrorFlag.store(true);
+                        continue;
+                    }
+                    devices_by_id[id].push_back(dev);
+                }
+            }
+
+            for (auto&& [id, devs] : devices_by_id)
+            {
+                CAN_RouteSpan& span = this->CAN_ReadSpan[i * K_CAN_ID_SPACE + id];
+                span.offset = static_cast<uint16_t>(this->CAN_ReadRoute.size());
+                span.count = static_cast<uint16_t>(devs.size());
+                this->CAN_ReadRoute.insert(this->CAN_ReadRoute.end(), devs.begin(), devs.end());
+                for (auto dev : devs)
+                {
+                    EncosJoint* joint = dynamic_cast<EncosJoint*>(dev);
+                    this->CAN_ReadJoint.push_back(joint != nullptr && joint->id_ == id ? joint : nullptr);
+                }
             }
         }
+
+        this->JointReplyBatch.Resize(slave_count * K_CAN_SLOT_NUM);
+        this->JointCommandBatch.Resize(slave_count * K_CAN_SLOT_NUM);
+    }
+
+    bool EncosBus::AllocateSlots(size_t slave, std::vector<std::vector<CAN_SlotEntry>>& slots)
+    {
+        slots.assign(K_CAN_SLOT_NUM, std::vector<CAN_SlotEntry>());
+
+        // devices polled every cycle take the first slots, latency critical devices go out first.
+        std::vector<Encos_CANBusDevice*> devs = this->CAN_Device_By_EtherCAT_ID[slave];
+        std::stable_sort(devs.begin(), devs.end(), [](Encos_CANBusDevice* a, Encos_CANBusDevice* b)
+            {
+                const bool a_fast = a->get_CAN_RateDivider() <= 1;
+                const bool b_fast = b->get_CAN_RateDivider() <= 1;
+                if (a_fast != b_fast)
+                    return a_fast;
+                return a->get_CAN_Priority() > b->get_CAN_Priority(); });
+
+        // two devices can share a slot if they are never due in the same cycle.
+        auto slot_free = [](const std::vector<CAN_SlotEntry>& slot, uint16_t divider, uint16_t phase)
+        {
+            for (auto&& entry : slot)
+            {
+                const uint16_t g = std::gcd(entry.divider, divider);
+                if (entry.phase % g == phase % g)
+                    return false;
+            }
+            return true;
+        };
+
+        double load[2] = { 0, 0 };
+        for (auto dev : devs)
+        {
+            const size_t channel = dev->get_CAN_Channel();
+            if (channel > 2)
+            {
+                this->logger_->error("Device {} is attached to unknown CAN channel {}, check your configuration xml.", dev->Id(), channel);
+                return false;
+            }
+            const size_t rate_div = std::max<size_t>(dev->get_CAN_RateDivider(), 1);
+            if (rate_div > UINT16_MAX)
+            {
+                this->logger_->error("Rate divider {} of device {} is too large, check your configuration xml.", rate_div, dev->Id());
+                return false;
+            }
+            const uint16_t divider = static_cast<uint16_t>(rate_div);
+
+            // devices without a channel fill CAN1 first, see BitbotEncosBusConfig.md
+            const size_t first_slot = channel == 2 ? K_CAN_SLOTS_PER_CHANNEL : 0;
+            const size_t last_slot = channel == 1 ? K_CAN_SLOTS_PER_CHANNEL : K_CAN_SLOT_NUM;
+            bool placed = false;
+            for (size_t s = first_slot; s < last_slot && !placed; s++)
+            {
+                for (uint16_t phase = 0; phase < divider && !placed; phase++)
+                {
+                    if (!slot_free(slots[s], divider, phase))
+                        continue;
+
+                    slots[s].push_back(CAN_SlotEntry{ dev, dynamic_cast<EncosJoint*>(dev), divider, phase });
+                    placed = true;
+                    load[s / K_CAN_SLOTS_PER_CHANNEL] += 1.0 / divider;
+                    this->logger_->info("EtherCAT slave {} slot {} (CAN{}): device {}, every {} cycle(s) at phase {}, dispatch offset {} us.",
+                        slave, s + 1, s / K_CAN_SLOTS_PER_CHANNEL + 1, dev->Id(), divider, phase, (s % K_CAN_SLOTS_PER_CHANNEL) * K_CAN_SLOT_INTERVAL_US);
+                }
+            }
+
+            if (!placed)
+            {
+                this->logger_->error("No free CAN slot for device {} on EtherCAT slave {}, increase rate_div of slow devices or check your configuration xml.", dev->Id(), slave);
+                return false;
+            }
+        }
+
+        // trailing empty slots are not sent, empty slots of CAN1 are kept as gaps when CAN2 is used.
+        while (!slots.empty() && slots.back().empty())
+        {
+            slots.pop_back();
+        }
+
+        if (std::abs(load[0] - load[1]) > 1.0)
+        {
+            this->logger_->warn("CAN channels of EtherCAT slave {} are unbalanced (CAN1: {:.2f}, CAN2: {:.2f} frames per cycle), consider moving devices to the other channel.", slave, load[0], load[1]);
+        }
+        return true;
     }
 
     void EncosBus::WriteBus()
@@ -172,48 +424,421 @@ namespace bitbot
             dev->WriteOnce();
         }
 
-        for (size_t i = 0; i < this->CAN_Device_By_EtherCAT_ID.size(); i++)
+        this->ApplyJointCommands();
+
+        for (size_t g = 0; g < K_MAX_GROUP; g++)
         {
-            for (size_t j = 0; j < this->CAN_Device_By_EtherCAT_ID[i].size(); j++)
+            this->GroupExchanged[g] = this->GroupUsed[g] && (this->cycle_cnt % this->GroupDivider[g] == 0);
+        }
+
+        for (size_t i = 0; i < this->CAN_WriteSpan.size(); i++)
+        {
+            // devices of a group which is not exchanged in this cycle keep their pending commands
+            if (!this->GroupExchanged[this->SlaveGroup[i]])
+                continue;
+
+            // slots shared by slow devices are multiplexed on the exchange count of the slave's group
+            const uint64_t exchange = this->cycle_cnt / this->GroupDivider[this->SlaveGroup[i]];
+            const CAN_RouteSpan span = this->CAN_WriteSpan[i];
+            EtherCAT_Msg* msg = this->CAN_BusWriteBuffer[i];
+            size_t device_number = 0;
+            for (size_t j = 0; j < span.count; j++)
             {
-                this->CAN_Device_By_EtherCAT_ID[i][j]->WriteBus(this->CAN_BusWriteBuffer[i]->device[j]);
+                const CAN_RouteSpan slot = this->CAN_SlotSpan[span.offset + j];
+                const CAN_SlotEntry* entries = this->CAN_WriteRoute.data() + slot.offset;
+                const CAN_SlotEntry* entry = nullptr;
+                for (size_t k = 0; k < slot.count; k++)
+                {
+                    if (exchange % entries[k].divider == entries[k].phase)
+                    {
+                        entry = entries + k;
+                        break;
+                    }
+                }
+
+                if (entry != nullptr) [[likely]]
+                {
+                    if (entry->joint == nullptr || !this->GatherJointCommand(entry->joint, msg->device[j]))
+                    {
+                        entry->device->WriteBus(msg->device[j]);
+                    }
+                    device_number = j + 1;
+                }
+                else
+                {
+                    msg->device[j].id = 0;
+                    msg->device[j].rtr = 0;
+                    msg->device[j].dlc = 0;
+                }
             }
-            this->CAN_BusWriteBuffer[i]->device_number = this->CAN_Device_By_EtherCAT_ID[i].size();
-            this->CAN_BusWriteBuffer[i]->can_ide = 0;
+            msg->device_number = static_cast<uint8_t>(device_number);
+            msg->can_ide = 0;
         }
-        ec_send_processdata();
+        this->JointCommandBatch.Encode();
+        this->SendProcessData();
+    }
+
+    void EncosBus::SendProcessData()
+    {
+        // the DC datagram rides on the first frame of the reference clock group, which must be the first frame received
+        if (this->DcGroup >= 0 && this->GroupExchanged[this->DcGroup])
+        {
+            ec_send_processdata_group(SoemGroup(this->DcGroup));
+        }
+        for (size_t g = 0; g < K_MAX_GROUP; g++)
+        {
+            if (this->GroupExchanged[g] && static_cast<int>(g) != this->DcGroup)
+            {
+                ec_send_processdata_group(SoemGroup(g));
+            }
+        }
+    }
+
+    int EncosBus::ReceiveProcessData()
+    {
+        // soem collects the frames of all groups sent so far in one call,
+        // the group passed in decides whether the first frame is read as the one carrying the DC datagram.
+        this->cycle_expected_wkc = 0;
+        int receive_group = -1;
+        for (size_t g = 0; g < K_MAX_GROUP; g++)
+        {
+            if (this->GroupExchanged[g])
+            {
+                this->cycle_expected_wkc += this->GroupExpectedWKC[g];
+                if (receive_group < 0)
+                    receive_group = static_cast<int>(g);
+            }
+        }
+
+        if (receive_group < 0)
+            return EC_NOFRAME;
+        if (this->DcGroup >= 0 && this->GroupExchanged[this->DcGroup])
+            receive_group = this->DcGroup;
+        return ec_receive_processdata_group(SoemGroup(receive_group), EC_TIMEOUTRET);
     }
 
     void EncosBus::ReadBus()
     {
+        // a DC correction is applied only in the cycle it is computed, the DC group may not be exchanged every cycle
+        this->dc_offset_time = 0;
+
         for (auto&& dev : this->VirtualBusDevices)
         {
             dev->ReadOnce();
         }
 
-        this->wkc = ec_receive_processdata(EC_TIMEOUTRET);
+        if (std::none_of(std::begin(this->GroupExchanged), std::end(this->GroupExchanged), [](bool exchanged)
+                { return exchanged; })) // nothing was sent in the last cycle
+        {
+            this->cycle_cnt++;
+            this->PublishStateSnapshot();
+            return;
+        }
+
+        this->wkc = this->ReceiveProcessData();
+        if (this->dc_enable && this->DcGroup >= 0 && this->GroupExchanged[this->DcGroup])
+        {
+            this->DistributedClockSync(ec_DCtime);
+        }
 
         for (size_t i = 0; i < this->CAN_BusReadBuffer.size(); i++)
         {
-            this->CAN_BusReadBuffer[i] = (EtherCAT_Msg*)(ec_slave[i + 1].inputs);
-            // std::cout<<static_cast<int>(this->CAN_BusReadBuffer[i]->device_number)<<std::endl;
-            for (size_t j = 0; j < this->CAN_BusReadBuffer[i]->device_number; j++)
+            // inputs of a group which was not exchanged are not updated
+            if (!this->GroupExchanged[this->SlaveGroup[i]])
+                continue;
+
+            const EtherCAT_Msg* msg = this->CAN_BusReadBuffer[i];
+            const CAN_RouteSpan* spans = this->CAN_ReadSpan.data() + i * K_CAN_ID_SPACE;
+            const size_t device_number = std::min<size_t>(msg->device_number, 6);
+            for (size_t j = 0; j < device_number; j++)
             {
-                size_t canid = this->CAN_BusReadBuffer[i]->device[j].id;
-                // std::cout<<canid<<"rtr"<<static_cast<int>(this->CAN_BusReadBuffer[i]->device[j].rtr)<<std::endl;
+                const uint32_t canid = msg->device[j].id;
+                if (canid >= K_CAN_ID_SPACE) [[unlikely]]
+                    continue;
 
-                for (auto dev : this->CAN_Device_By_CAN_ID[canid])
+                const CAN_RouteSpan span = spans[canid];
+                Encos_CANBusDevice* const* devs = this->CAN_ReadRoute.data() + span.offset;
+                EncosJoint* const* joints = this->CAN_ReadJoint.data() + span.offset;
+                for (size_t k = 0; k < span.count; k++)
                 {
-                    dev->ReadBus(this->CAN_BusReadBuffer[i]->device[j]);
+                    if (joints[k] != nullptr && this->GatherJointReply(joints[k], msg->device[j])) [[likely]]
+                        continue;
+                    devs[k]->ReadBus(msg->device[j]);
                 }
             }
         }
+        this->PublishJointReplies();
+
+        this->cycle_cnt++;
+        this->UpdateLinkStatistics();
+        this->PublishLinkSnapshot();
+        this->PublishStateSnapshot();
+
+        EtherCAT_CycleReport report;
+        report.cycle = this->cycle_cnt;
+        report.wkc = this->wkc;
+        report.expected_wkc = this->cycle_expected_wkc;
+        this->SupervisorQueue.try_enqueue(report); // never blocks, the report is dropped if the supervisor falls behind
+    }
+
+    void EncosJointReplyBatch::Resize(size_t capacity)
+    {
+        this->count = 0;
+        this->joint.resize(capacity);
+        this->error_code.resize(capacity);
+        for (auto v : { &this->position_raw, &this->velocity_raw, &this->current_raw })
+        {
+            v->resize(capacity);
+        }
+        for (auto v : { &this->motor_temp_raw, &this->driver_temp_raw })
+        {
+            v->resize(capacity);
+        }
+        for (auto v : { &this->position_mul, &this->position_add, &this->velocity_mul, &this->velocity_add, &this->current_mul, &this->current_add,
+                 &this->position, &this->velocity, &this->current, &this->motor_temp, &this->driver_temp })
+        {
+            v->resize(capacity);
+        }
+    }
 
-        if (this->check_cnt % this->check_cycle == 0)
+    void EncosJointReplyBatch::Decode()
+    {
+        const size_t n = this->count;
+        const uint16_t* __restrict pos_raw = this->position_raw.data();
+        const uint16_t* __restrict vel_raw = this->velocity_raw.data();
+        const uint16_t* __restrict cur_raw = this->current_raw.data();
+        const uint8_t* __restrict mt_raw = this->motor_temp_raw.data();
+        const uint8_t* __restrict dt_raw = this->driver_temp_raw.data();
+        const float* __restrict pos_mul = this->position_mul.data();
+        const float* __restrict pos_add = this->position_add.data();
+        const float* __restrict vel_mul = this->velocity_mul.data();
+        const float* __restrict vel_add = this->velocity_add.data();
+        const float* __restrict cur_mul = this->current_mul.data();
+        const float* __restrict cur_add = this->current_add.data();
+        float* __restrict pos = this->position.data();
+        float* __restrict vel = this->velocity.data();
+        float* __restrict cur = this->current.data();
+        float* __restrict mt = this->motor_temp.data();
+        float* __restrict dt = this->driver_temp.data();
+
+        // branch free loops over contiguous arrays, vectorized by the compiler
+        for (size_t i = 0; i < n; i++)
+        {
+            pos[i] = static_cast<float>(pos_raw[i]) * pos_mul[i] + pos_add[i];
+            vel[i] = static_cast<float>(vel_raw[i]) * vel_mul[i] + vel_add[i];
+            cur[i] = static_cast<float>(cur_raw[i]) * cur_mul[i] + cur_add[i];
+        }
+        for (size_t i = 0; i < n; i++)
         {
-            this->EtherCATStateCheck();
+            mt[i] = (static_cast<float>(mt_raw[i]) - 50.0f) * 0.5f;
+            dt[i] = (static_cast<float>(dt_raw[i]) - 50.0f) * 0.5f;
+        }
+    }
+
+    bool EncosBus::GatherJointReply(EncosJoint* joint, const CAN_Device_Msg& frame)
+    {
+        using namespace EncosFrame;
+        EncosJointReplyBatch& batch = this->JointReplyBatch;
+        if (frame.dlc != ReplyType1::Layout::dlc || batch.count >= batch.joint.size()) [[unlikely]]
+            return false;
+
+        const uint64_t word = ReplyType1::Layout::Load(frame);
+        if (ReplyHeader::AckType::Get(word) != 1) [[unlikely]]
+            return false;
+
+        const MotorConigurationData* cfg = joint->ConfigData__;
+        const float direction = static_cast<float>(cfg->MOTOR_DIRECTION);
+        const size_t i = batch.count++;
+        batch.joint[i] = joint;
+        batch.error_code[i] = static_cast<uint8_t>(ReplyHeader::ErrorCode::Get(word));
+        batch.position_raw[i] = static_cast<uint16_t>(ReplyType1::Position::Get(word));
+        batch.velocity_raw[i] = static_cast<uint16_t>(ReplyType1::Velocity::Get(word));
+        batch.current_raw[i] = static_cast<uint16_t>(ReplyType1::Current::Get(word));
+        batch.motor_temp_raw[i] = static_cast<uint8_t>(ReplyType1::MotorTemperature::Get(word));
+        batch.driver_temp_raw[i] = static_cast<uint8_t>(ReplyType1::DriverTemperature::Get(word));
+        batch.position_mul[i] = cfg->POS_SCALE.to_float * direction;
+        batch.position_add[i] = cfg->POS_SCALE.min * direction;
+        batch.velocity_mul[i] = cfg->SPD_SCALE.to_float * direction;
+        batch.velocity_add[i] = cfg->SPD_SCALE.min * direction;
+        batch.current_mul[i] = cfg->I_SCALE.to_float * direction;
+        batch.current_add[i] = cfg->I_SCALE.min * direction;
+        return true;
+    }
+
+    void EncosBus::PublishJointReplies()
+    {
+        EncosJointReplyBatch& batch = this->JointReplyBatch;
+        if (batch.count == 0)
+            return;
+
+        batch.Decode();
+        for (size_t i = 0; i < batch.count; i++)
+        {
+            EncosJoint* joint = batch.joint[i];
+            // called for every reply so that the recovery of a fault is detected
+            joint->ProcessErrorCode(batch.error_code[i]);
+
+            joint->StoreState(batch.position[i], batch.velocity[i], batch.current[i], batch.motor_temp[i], batch.driver_temp[i]);
+        }
+        batch.count = 0;
+    }
+
+    void EncosJointCommandBatch::Resize(size_t capacity)
+    {
+        this->count = 0;
+        this->frame.resize(capacity);
+        for (auto v : { &this->kp, &this->kd, &this->position, &this->velocity, &this->torque,
+                 &this->kp_mul, &this->kp_min, &this->kd_mul, &this->kd_min, &this->position_mul, &this->position_min,
+                 &this->velocity_mul, &this->velocity_min, &this->torque_mul, &this->torque_min })
+        {
+            v->resize(capacity);
+        }
+        for (auto v : { &this->kp_int, &this->kd_int, &this->position_int, &this->velocity_int, &this->torque_int })
+        {
+            v->resize(capacity);
+        }
+    }
+
+    void EncosJointCommandBatch::Encode()
+    {
+        using Frame = EncosFrame::MotionCommand;
+        const size_t n = this->count;
+        if (n == 0)
+            return;
+
+        EncosQuantizeBatch(n, this->kp.data(), this->kp_mul.data(), this->kp_min.data(), Frame::Kp::max, this->kp_int.data());
+        EncosQuantizeBatch(n, this->kd.data(), this->kd_mul.data(), this->kd_min.data(), Frame::Kd::max, this->kd_int.data());
+        EncosQuantizeBatch(n, this->position.data(), this->position_mul.data(), this->position_min.data(), Frame::Position::max, this->position_int.data());
+        EncosQuantizeBatch(n, this->velocity.data(), this->velocity_mul.data(), this->velocity_min.data(), Frame::Velocity::max, this->velocity_int.data());
+        EncosQuantizeBatch(n, this->torque.data(), this->torque_mul.data(), this->torque_min.data(), Frame::Torque::max, this->torque_int.data());
+
+        for (size_t i = 0; i < n; i++)
+        {
+            Frame::Layout::Pack(*this->frame[i], Frame::header, this->kp_int[i], this->kd_int[i], this->position_int[i], this->velocity_int[i], this->torque_int[i]);
+        }
+        this->count = 0;
+    }
+
+    bool EncosBus::GatherJointCommand(EncosJoint* joint, CAN_Device_Msg& frame)
+    {
+        EncosJointCommandBatch& batch = this->JointCommandBatch;
+        if (joint->isConfig__ != 0 || !joint->Enable__ || !joint->PowerOn__ || batch.count >= batch.frame.size()) [[unlikely]]
+            return false;
+
+        // same order as EncosJoint::WriteBus, a high priority command issued in between is not lost
+        joint->HighPriorityCommandWriting__.store(false);
+        if (joint->WriteCmdType__.load() != EncosJoint::WriteCmdType_e::MOTION_CONTROL) [[unlikely]]
+        {
+            joint->WriteBus(frame);
+            return true;
+        }
+        if (joint->WriteBusConfig(frame)) [[unlikely]]
+            return true;
+
+        const MotorConigurationData* cfg = joint->ConfigData__;
+        const MotorRuntimeData& data = joint->RuntimeData__;
+        const float direction = static_cast<float>(cfg->MOTOR_DIRECTION);
+        const size_t i = batch.count++;
+        frame.id = joint->id_;
+        batch.frame[i] = &frame;
+        batch.kp[i] = data.Kp.load(std::memory_order_relaxed);
+        batch.kd[i] = data.Kd.load(std::memory_order_relaxed);
+        batch.position[i] = data.TargetPosition.load(std::memory_order_relaxed) * direction;
+        batch.velocity[i] = data.TargetVelocity.load(std::memory_order_relaxed) * direction;
+        batch.torque[i] = data.TargetTorque.load(std::memory_order_relaxed) * direction;
+        batch.kp_mul[i] = cfg->KP_SCALE.to_int;
+        batch.kp_min[i] = cfg->KP_SCALE.min;
+        batch.kd_mul[i] = cfg->KD_SCALE.to_int;
+        batch.kd_min[i] = cfg->KD_SCALE.min;
+        batch.position_mul[i] = cfg->POS_SCALE.to_int;
+        batch.position_min[i] = cfg->POS_SCALE.min;
+        batch.velocity_mul[i] = cfg->SPD_SCALE.to_int;
+        batch.velocity_min[i] = cfg->SPD_SCALE.min;
+        batch.torque_mul[i] = cfg->T_SCALE.to_int;
+        batch.torque_min[i] = cfg->T_SCALE.min;
+        return true;
+    }
+
+    namespace
+    {
+        // NaN is replaced by the lower limit
+        inline float ClampCommand(float x, float lo, float hi)
+        {
+            return std::fmin(std::fmax(x, lo), hi);
+        }
+    }
+
+    bool EncosBus::SetJointCommands(std::span<const size_t> joints, std::span<const float> position, std::span<const float> velocity,
+        std::span<const float> torque, std::span<const float> kp, std::span<const float> kd, std::span<uint8_t> rejected)
+    {
+        const size_t n = joints.size();
+        if (position.size() != n || velocity.size() != n || torque.size() != n || kp.size() != n || kd.size() != n || rejected.size() != n) [[unlikely]]
+            return false;
+
+        JointCommandTable& staging = this->JointCommandStaging;
+        const JointCommandTable& lo = this->JointCommandMin;
+        const JointCommandTable& hi = this->JointCommandMax;
+        const size_t joint_num = staging.Size();
+        const uint64_t seq = ++this->JointCommandSeq;
+        for (size_t k = 0; k < n; k++)
+        {
+            const size_t i = joints[k];
+            rejected[k] = i >= joint_num || this->Joints[i]->JointMode__ != EncosJointMode::Motion;
+            if (rejected[k]) [[unlikely]]
+                continue;
+            staging.position[i] = ClampCommand(position[k], lo.position[i], hi.position[i]);
+            staging.velocity[i] = ClampCommand(velocity[k], lo.velocity[i], hi.velocity[i]);
+            staging.torque[i] = ClampCommand(torque[k], lo.torque[i], hi.torque[i]);
+            staging.kp[i] = ClampCommand(kp[k], lo.kp[i], hi.kp[i]);
+            staging.kd[i] = ClampCommand(kd[k], lo.kd[i], hi.kd[i]);
+            staging.stamp[i] = seq;
+        }
+        staging.seq = seq;
+
+        // the back buffer may be several commits old, it receives every joint committed since it was last written
+        JointCommandTable& back = this->JointCommandMailbox.WriteBuffer();
+        for (size_t i = 0; i < joint_num; i++)
+        {
+            if (staging.stamp[i] <= back.seq)
+                continue;
+            back.position[i] = staging.position[i];
+            back.velocity[i] = staging.velocity[i];
+            back.torque[i] = staging.torque[i];
+            back.kp[i] = staging.kp[i];
+            back.kd[i] = staging.kd[i];
+            back.stamp[i] = staging.stamp[i];
+        }
+        back.seq = seq;
+        this->JointCommandMailbox.Publish();
+        return true;
+    }
+
+    void EncosBus::ApplyJointCommands()
+    {
+        const JointCommandTable* commit = this->JointCommandMailbox.Acquire();
+        if (commit == nullptr) [[likely]]
+            return;
+
+        // only joints committed after the last applied commit are written, older commits must not overwrite targets set since then
+        const JointCommandTable& cmd = *commit;
+        const uint64_t applied = this->JointCommandApplied;
+        this->JointCommandApplied = cmd.seq;
+        for (size_t i = 0; i < this->Joints.size(); i++)
+        {
+            EncosJoint* joint = this->Joints[i];
+            // the mode may have been changed after the commit
+            if (cmd.stamp[i] <= applied || joint->JointMode__ != EncosJointMode::Motion)
+                continue;
+
+            MotorRuntimeData& data = joint->RuntimeData__;
+            data.TargetPosition.store(cmd.position[i], std::memory_order_relaxed);
+            data.TargetVelocity.store(cmd.velocity[i], std::memory_order_relaxed);
+            data.TargetTorque.store(cmd.torque[i], std::memory_order_relaxed);
+            data.Kp.store(cmd.kp[i], std::memory_order_relaxed);
+            data.Kd.store(cmd.kd[i], std::memory_order_relaxed);
+            if (!joint->HighPriorityCommandWriting__.load()) // write this command only when high priority command is not writing the bus.
+                joint->WriteCmdType__ = EncosJoint::WriteCmdType_e::MOTION_CONTROL;
         }
-        this->check_cnt++;
     }
 
     bool EncosBus::InitEtherCAT(const std::string& ifname)
@@ -240,8 +865,71 @@ namespace bitbot
                 for (int slave_idx = 0; slave_idx < ec_slavecount; slave_idx++)
                     ec_slave[slave_idx + 1].CoEdetails &= ~ECT_COEDET_SDOCA;
 
-                ec_config_map(&IOmap);
-                ec_configdc();
+                this->SlaveGroup.assign(ec_slavecount, 0);
+                for (auto&& [slave, group] : this->SlaveGroupConfig)
+                {
+                    if (slave >= static_cast<size_t>(ec_slavecount))
+                    {
+                        this->logger_->warn("EtherCAT slave {} of process data group {} is not found.", slave, group);
+                        continue;
+                    }
+                    this->SlaveGroup[slave] = group;
+                }
+                for (int slave_idx = 0; slave_idx < ec_slavecount; slave_idx++)
+                    ec_slave[slave_idx + 1].group = SoemGroup(this->SlaveGroup[slave_idx]);
+                for (size_t g = 0; g < K_MAX_GROUP; g++)
+                {
+                    this->GroupUsed[g] = std::find(this->SlaveGroup.begin(), this->SlaveGroup.end(), g) != this->SlaveGroup.end();
+                }
+
+                // soem only places the groups one after another in the IOmap, the budget is checked before the next group is placed
+                size_t iomap_size = 0;
+                for (size_t g = 0; g < K_MAX_GROUP; g++)
+                {
+                    if (!this->GroupUsed[g])
+                        continue;
+                    iomap_size += static_cast<size_t>(ec_config_map_group(IOmap + iomap_size, SoemGroup(g)));
+                    if (iomap_size > sizeof(IOmap))
+                    {
+                        this->logger_->error("IOmap overflow, at least {} bytes required.", iomap_size);
+                        return false;
+                    }
+                    this->logger_->debug("Process data group {} mapped, divider {}, segments {}.", g, this->GroupDivider[g], ec_group[SoemGroup(g)].nsegments);
+                }
+                bool has_dc = ec_configdc();
+
+                // soem sends the DC datagram with the group of the reference clock, the first DC slave
+                this->DcGroup = -1;
+                if (has_dc)
+                {
+                    this->DcGroup = this->SlaveGroup[ec_slave[0].DCnext - 1];
+                    if (this->dc_enable && this->GroupDivider[this->DcGroup] != 1)
+                        this->logger_->warn("The reference clock is in process data group {}, distributed clock is synchronized every {} cycles.", this->DcGroup, this->GroupDivider[this->DcGroup]);
+                }
+
+                if (this->dc_enable)
+                {
+                    if (has_dc)
+                    {
+                        for (int slave_idx = 1; slave_idx <= ec_slavecount; slave_idx++)
+                        {
+                            if (ec_slave[slave_idx].hasdc)
+                            {
+                                ec_dcsync0(slave_idx, TRUE, static_cast<uint32>(this->dc_cycle_time), this->dc_sync_shift);
+                            }
+                            else
+                            {
+                                this->logger_->warn("EtherCAT slave {} does not support distributed clock, it will run in free run mode.", slave_idx - 1);
+                            }
+                        }
+                        this->logger_->info("Distributed clock SYNC0 enabled, cycle time {} ns, shift {} ns.", this->dc_cycle_time, this->dc_sync_shift);
+                    }
+                    else
+                    {
+                        this->dc_enable = false;
+                        this->logger_->warn("No EtherCAT slave supports distributed clock, fallback to free run mode.");
+                    }
+                }
 
                 this->logger_->info("Slaves mapped.");
                 /* wait for all slaves to reach SAFE_OP state */
@@ -271,27 +959,34 @@ namespace bitbot
                 if (iloop > 8)
                     iloop = 8;
 
-                info = std::string("segments : ") + std::to_string(ec_group[0].nsegments) + " : " + std::to_string(ec_group[0].IOsegment[0]) + " " + std::to_string(ec_group[0].IOsegment[1]) + " " + std::to_string(ec_group[0].IOsegment[2]) + " " + std::to_string(ec_group[0].IOsegment[3]);
-                this->logger_->debug(info);
-
                 this->logger_->debug("Requesting operational state for all slaves...");
-                expectedWKC = (ec_group[0].outputsWKC * 2) + ec_group[0].inputsWKC;
+                expectedWKC = 0;
+                for (size_t g = 0; g < K_MAX_GROUP; g++)
+                {
+                    this->GroupExpectedWKC[g] = this->GroupUsed[g] ? (ec_group[SoemGroup(g)].outputsWKC * 2) + ec_group[SoemGroup(g)].inputsWKC : 0;
+                    this->GroupExchanged[g] = this->GroupUsed[g];
+                    expectedWKC += this->GroupExpectedWKC[g];
+                }
                 info = std::string("Calculated workcounter ") + std::to_string(expectedWKC);
                 this->logger_->debug(info);
                 ec_slave[0].state = EC_STATE_OPERATIONAL;
                 /* send one valid process data to make outputs in slaves happy*/
-                ec_send_processdata();
-                ec_receive_processdata(EC_TIMEOUTRET);
+                this->SendProcessData();
+                this->ReceiveProcessData();
                 /* request OP state for all slaves */
                 ec_writestate(0);
                 chk = 40;
                 /* wait for all slaves to reach OP state */
                 do
                 {
-                    ec_send_processdata();
-                    ec_receive_processdata(EC_TIMEOUTRET);
+                    this->SendProcessData();
+                    this->ReceiveProcessData();
                     ec_statecheck(0, EC_STATE_OPERATIONAL, 50000);
                 } while (chk-- && (ec_slave[0].state != EC_STATE_OPERATIONAL));
+                for (size_t g = 0; g < K_MAX_GROUP; g++)
+                {
+                    this->GroupExchanged[g] = false;
+                }
 
                 if (ec_slave[0].state == EC_STATE_OPERATIONAL)
                 {
@@ -330,6 +1025,165 @@ namespace bitbot
         return false;
     }
 
+    void EncosBus::ConfigureDistributedClock(bool enable, uint32_t cycle_time, int32_t sync_shift)
+    {
+        this->dc_enable = enable;
+        this->dc_cycle_time = cycle_time;
+        this->dc_sync_shift = sync_shift;
+        this->dc_integral = 0;
+        this->dc_offset_time = 0;
+    }
+
+    bool EncosBus::ConfigureProcessDataGroup(uint8_t group, uint32_t divider, const std::vector<size_t>& slaves)
+    {
+        static_assert(SoemGroup(K_MAX_GROUP - 1) < EC_MAXGROUP, "soem does not support so many process data groups");
+
+        if (group >= K_MAX_GROUP)
+        {
+            this->logger_->error("Process data group {} is out of range, at most {} groups are supported.", group, K_MAX_GROUP);
+            return false;
+        }
+        if (divider == 0 || (group == 0 && divider != 1))
+        {
+            this->logger_->error("Invalid divider {} for process data group {}, group 0 is always exchanged every cycle.", divider, group);
+            return false;
+        }
+
+        for (size_t i = 0; i < slaves.size(); i++)
+        {
+            const size_t slave = slaves[i];
+            const bool assigned = std::find(slaves.begin(), slaves.begin() + i, slave) != slaves.begin() + i ||
+                                  std::any_of(this->SlaveGroupConfig.begin(), this->SlaveGroupConfig.end(), [slave](const auto& entry)
+                                      { return entry.first == slave; });
+            if (assigned)
+            {
+                this->logger_->error("EtherCAT slave {} is assigned to more than one process data group.", slave);
+                return false;
+            }
+        }
+
+        this->GroupDivider[group] = divider;
+        for (auto slave : slaves)
+        {
+            this->SlaveGroupConfig.emplace_back(slave, group);
+        }
+        return true;
+    }
+
+    void EncosBus::PublishStateSnapshot()
+    {
+        static_assert(std::is_trivially_copyable_v<ImuStateSnapshot> && sizeof(ImuStateSnapshot) % sizeof(uint32_t) == 0);
+
+        const size_t n = this->Joints.size();
+        const uint64_t cycle = this->cycle_cnt;
+        this->StateSnapshot.BeginWrite();
+        this->StateSnapshot.Store(0, &cycle, 2);
+        size_t offset = 2;
+        for (auto v : { &this->JointStates.position, &this->JointStates.velocity, &this->JointStates.current,
+                 &this->JointStates.torque, &this->JointStates.motor_temperature, &this->JointStates.driver_temperature })
+        {
+            this->StateSnapshot.Store(offset, v->data(), n);
+            offset += n;
+        }
+        for (auto imu : this->Imus)
+        {
+            const ImuStateSnapshot state = imu->GetState();
+            this->StateSnapshot.Store(offset, &state, K_IMU_SNAPSHOT_WORDS);
+            offset += K_IMU_SNAPSHOT_WORDS;
+        }
+        this->StateSnapshot.EndWrite();
+    }
+
+    bool EncosBus::GetStateSnapshot(RobotStateSnapshot& snapshot) const
+    {
+        snapshot.raw.resize(this->StateSnapshot.Size());
+        if (snapshot.raw.empty() || this->StateSnapshot.Read(snapshot.raw.data()) == 0)
+            return false;
+
+        const uint32_t* raw = snapshot.raw.data();
+        std::memcpy(&snapshot.cycle, raw, sizeof(uint64_t));
+        size_t offset = 2;
+        const size_t n = this->Joints.size();
+        for (auto v : { &snapshot.position, &snapshot.velocity, &snapshot.current,
+                 &snapshot.torque, &snapshot.motor_temperature, &snapshot.driver_temperature })
+        {
+            v->resize(n);
+            std::memcpy(v->data(), raw + offset, n * sizeof(float));
+            offset += n;
+        }
+        snapshot.imu.resize(this->Imus.size());
+        for (auto& imu : snapshot.imu)
+        {
+            std::memcpy(static_cast<void*>(&imu), raw + offset, sizeof(ImuStateSnapshot));
+            offset += K_IMU_SNAPSHOT_WORDS;
+        }
+        return true;
+    }
+
+    const std::vector<EncosJoint*>& EncosBus::GetJoints() const
+    {
+        return this->Joints;
+    }
+
+    std::span<const float> EncosBus::JointPositions() const
+    {
+        return this->JointStates.position;
+    }
+
+    std::span<const float> EncosBus::JointVelocities() const
+    {
+        return this->JointStates.velocity;
+    }
+
+    std::span<const float> EncosBus::JointCurrents() const
+    {
+        return this->JointStates.current;
+    }
+
+    std::span<const float> EncosBus::JointTorques() const
+    {
+        return this->JointStates.torque;
+    }
+
+    std::span<const float> EncosBus::JointMotorTemperatures() const
+    {
+        return this->JointStates.motor_temperature;
+    }
+
+    std::span<const float> EncosBus::JointDriverTemperatures() const
+    {
+        return this->JointStates.driver_temperature;
+    }
+
+    bool EncosBus::DistributedClockEnabled() const
+    {
+        return this->dc_enable;
+    }
+
+    int64_t EncosBus::DistributedClockOffset() const
+    {
+        return this->dc_offset_time;
+    }
+
+    void EncosBus::DistributedClockSync(int64_t reftime)
+    {
+        // PI controller from SOEM red_test, lock the moment process data is sent to the start of DC cycle.
+        int64_t delta = reftime % this->dc_cycle_time;
+        if (delta > (this->dc_cycle_time / 2))
+        {
+            delta = delta - this->dc_cycle_time;
+        }
+        if (delta > 0)
+        {
+            this->dc_integral++;
+        }
+        if (delta < 0)
+        {
+            this->dc_integral--;
+        }
+        this->dc_offset_time = -(delta / 100) - (this->dc_integral / 20);
+    }
+
     std::vector<Encos_CANBusDevice*> EncosBus::get_CAN_Devices()
     {
         std::vector<Encos_CANBusDevice*> can_devices;
@@ -355,7 +1209,236 @@ namespace bitbot
         return this->VirtualBusDevices;
     }
 
-    void EncosBus::EtherCATStateCheck()
+    void EncosBus::UpdateLinkStatistics()
+    {
+        EtherCAT_LinkStatistics& stat = this->LinkStatistics;
+        stat.last_wkc = this->wkc;
+        stat.expected_wkc = this->cycle_expected_wkc;
+
+        if (this->wkc >= this->cycle_expected_wkc) [[likely]]
+        {
+            stat.miss_streak = 0;
+            for (size_t i = 0; i < this->SlaveInputsStaleSince.size(); i++)
+            {
+                if (this->GroupExchanged[this->SlaveGroup[i]])
+                    this->SlaveInputsStaleSince[i] = 0;
+            }
+            return;
+        }
+
+        stat.miss_streak++;
+        stat.max_miss_streak = std::max(stat.max_miss_streak, stat.miss_streak);
+
+        bool attributed = false;
+        if (this->wkc < 0) // no frame received
+        {
+            stat.lost_frames++;
+        }
+        else
+        {
+            stat.short_wkc++;
+            // the faulted slaves are only known after the supervisor has checked them,
+            // so the first cycles of a fault can not be attributed and mark every slave below
+            for (size_t i = 0; i < this->SlaveInputsStaleSince.size(); i++)
+            {
+                if (this->GroupExchanged[this->SlaveGroup[i]] && this->SlaveFault[i].load(std::memory_order_relaxed))
+                {
+                    attributed = true;
+                    if (this->SlaveInputsStaleSince[i] == 0)
+                        this->SlaveInputsStaleSince[i] = this->cycle_cnt;
+                }
+            }
+
+            // the other exchanged slaves answered, including those marked before the fault was attributed
+            if (attributed)
+            {
+                for (size_t i = 0; i < this->SlaveInputsStaleSince.size(); i++)
+                {
+                    if (this->GroupExchanged[this->SlaveGroup[i]] && !this->SlaveFault[i].load(std::memory_order_relaxed))
+                        this->SlaveInputsStaleSince[i] = 0;
+                }
+            }
+        }
+
+        // the missing slave is unknown, none of the inputs can be trusted
+        if (!attributed)
+        {
+            for (size_t i = 0; i < this->SlaveInputsStaleSince.size(); i++)
+            {
+                if (this->GroupExchanged[this->SlaveGroup[i]] && this->SlaveInputsStaleSince[i] == 0)
+                    this->SlaveInputsStaleSince[i] = this->cycle_cnt;
+            }
+        }
+    }
+
+    void EncosBus::PublishLinkSnapshot()
+    {
+        static_assert(sizeof(EtherCAT_LinkStatistics) % sizeof(uint32_t) == 0 && sizeof(EncosCycleJitter) % sizeof(uint32_t) == 0);
+        constexpr size_t word = sizeof(uint32_t);
+        constexpr size_t stat_words = sizeof(EtherCAT_LinkStatistics) / word;
+        constexpr size_t jitter_words = sizeof(EncosCycleJitter) / word;
+
+        this->LinkSnapshot.BeginWrite();
+        this->LinkSnapshot.Store(0, &this->LinkStatistics, stat_words);
+        this->LinkSnapshot.Store(stat_words, &this->CycleJitter, jitter_words);
+        this->LinkSnapshot.Store(stat_words + jitter_words, this->SlaveInputsStaleSince.data(), this->SlaveInputsStaleSince.size() * sizeof(uint64_t) / word);
+        this->LinkSnapshot.EndWrite();
+    }
+
+    EncosRtLogger& EncosBus::GetRtLogger()
+    {
+        return this->ControlRtLogger;
+    }
+
+    const EtherCAT_LinkStatistics& EncosBus::GetLinkStatistics() const
+    {
+        return this->LinkStatistics;
+    }
+
+    uint64_t EncosBus::InputsStaleSince(size_t slave_id) const
+    {
+        if (slave_id >= this->SlaveInputsStaleSince.size())
+            return 0;
+        return this->SlaveInputsStaleSince[slave_id];
+    }
+
+    void EncosBus::UpdateRuntimeData()
+    {
+        BusManagerTpl<EncosBus, EncosDevice>::UpdateRuntimeData();
+        if (this->LinkMonitorData.empty())
+            return;
+
+        this->UpdateLinkMonitorData();
+        this->bus_monitor_data_.insert(this->bus_monitor_data_.end(), this->LinkMonitorData.begin(), this->LinkMonitorData.end());
+    }
+
+    size_t EncosBus::MonitorSampleWords() const
+    {
+        size_t words = 0;
+        for (auto&& device : this->devices_)
+        {
+            words += device->MonitorSampleWords();
+        }
+        return words;
+    }
+
+    size_t EncosBus::LinkMonitorSize() const
+    {
+        return this->LinkMonitorData.size();
+    }
+
+    void EncosBus::CaptureMonitorSample(uint32_t* sample, Number* link)
+    {
+        for (auto&& device : this->devices_)
+        {
+            device->CaptureMonitorSample(sample);
+            sample += device->MonitorSampleWords();
+        }
+        if (this->LinkMonitorData.empty())
+            return;
+
+        this->UpdateLinkMonitorData();
+        std::copy(this->LinkMonitorData.begin(), this->LinkMonitorData.end(), link);
+    }
+
+    void EncosBus::UpdateMonitorData(const uint32_t* sample, const Number* link, std::vector<Number>& data)
+    {
+        for (auto&& device : this->devices_)
+        {
+            device->UpdateMonitorData(sample);
+            sample += device->MonitorSampleWords();
+            data.insert(data.end(), device->MonitorData().begin(), device->MonitorData().end());
+        }
+        data.insert(data.end(), link, link + this->LinkMonitorData.size());
+    }
+
+    void EncosBus::UpdateLinkMonitorData()
+    {
+        // the bus loop may run in another thread, read a consistent copy of what it published
+        constexpr size_t word = sizeof(uint32_t);
+        EtherCAT_LinkStatistics stat;
+        EncosCycleJitter jitter;
+        this->LinkSnapshot.Read(this->LinkSnapshotWords.data());
+        std::memcpy(static_cast<void*>(&stat), this->LinkSnapshotWords.data(), sizeof(stat));
+        std::memcpy(static_cast<void*>(&jitter), this->LinkSnapshotWords.data() + sizeof(stat) / word, sizeof(jitter));
+        const uint32_t* stale = this->LinkSnapshotWords.data() + (sizeof(stat) + sizeof(jitter)) / word;
+
+        const EncosOverrunStatistics& overrun = this->OverrunStatistics;
+        size_t k = 0;
+        this->LinkMonitorData[k++] = static_cast<int64_t>(stat.last_wkc);
+        this->LinkMonitorData[k++] = static_cast<int64_t>(stat.expected_wkc);
+        this->LinkMonitorData[k++] = stat.lost_frames;
+        this->LinkMonitorData[k++] = stat.short_wkc;
+        this->LinkMonitorData[k++] = stat.miss_streak;
+        this->LinkMonitorData[k++] = stat.max_miss_streak;
+        this->LinkMonitorData[k++] = this->RtLogger.DroppedCount() + this->ControlRtLogger.DroppedCount();
+        this->LinkMonitorData[k++] = jitter.min_us;
+        this->LinkMonitorData[k++] = jitter.max_us;
+        this->LinkMonitorData[k++] = jitter.p99_us;
+        this->LinkMonitorData[k++] = overrun.overruns;
+        this->LinkMonitorData[k++] = overrun.missed_deadlines;
+        this->LinkMonitorData[k++] = overrun.max_streak;
+        this->LinkMonitorData[k++] = overrun.max_process_us;
+        for (size_t i = 0; i < EncosOverrunStatistics::K_PROCESS_BINS; i++)
+        {
+            this->LinkMonitorData[k++] = overrun.process_histogram[i];
+        }
+        for (size_t i = 0; i < this->SlaveInputsStaleSince.size(); i++)
+        {
+            uint64_t since;
+            std::memcpy(&since, stale + i * sizeof(uint64_t) / word, sizeof(since));
+            this->LinkMonitorData[k++] = since;
+        }
+    }
+
+    void EncosBus::SetCycleJitter(const EncosCycleJitter& jitter)
+    {
+        this->CycleJitter = jitter;
+    }
+
+    void EncosBus::SetOverrunStatistics(const EncosOverrunStatistics& stat)
+    {
+        this->OverrunStatistics = stat;
+    }
+
+    void EncosBus::StartSupervisor()
+    {
+        if (this->SupervisorThread.joinable())
+            return;
+        this->SupervisorRun.store(true);
+        this->SupervisorThread = std::thread(&EncosBus::SupervisorLoop, this);
+    }
+
+    void EncosBus::StopSupervisor()
+    {
+        this->SupervisorRun.store(false);
+        if (this->SupervisorThread.joinable())
+            this->SupervisorThread.join();
+    }
+
+    void EncosBus::SupervisorLoop()
+    {
+        EtherCAT_CycleReport report;
+        while (this->SupervisorRun.load())
+        {
+            bool received = false;
+            bool wkc_short = false;
+            while (this->SupervisorQueue.try_dequeue(report))
+            {
+                received = true;
+                wkc_short |= report.wkc < report.expected_wkc;
+            }
+
+            // only supervise while the bus loop is running
+            if (received)
+            {
+                this->EtherCATStateCheck(wkc_short);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(K_SUPERVISOR_PERIOD_MS));
+        }
+    }
+
+    void EncosBus::EtherCATStateCheck(bool wkc_short)
     {
         // count errors
         if (err_iteration_count > K_ETHERCAT_ERR_PERIOD)
@@ -371,7 +1454,13 @@ namespace bitbot
         }
         err_iteration_count++;
 
-        if (inOP && ((wkc < expectedWKC) || ec_group[currentgroup].docheckstate))
+        bool docheckstate = false;
+        for (size_t g = 0; g < K_MAX_GROUP; g++)
+        {
+            docheckstate |= this->GroupUsed[g] && ec_group[SoemGroup(g)].docheckstate;
+        }
+
+        if (inOP && (wkc_short || docheckstate))
         {
             if (needlf)
             {
@@ -379,18 +1468,24 @@ namespace bitbot
                 printf("\n");
             }
             /* one ore more slaves are not responding */
-            ec_group[currentgroup].docheckstate = FALSE;
+            for (size_t g = 0; g < K_MAX_GROUP; g++)
+            {
+                ec_group[SoemGroup(g)].docheckstate = FALSE;
+            }
             ec_readstate();
             for (int slave = 1; slave <= ec_slavecount; slave++)
             {
-                if ((ec_slave[slave].group == currentgroup) && (ec_slave[slave].state != EC_STATE_OPERATIONAL))
+                if (this->SlaveFault != nullptr)
+                {
+                    this->SlaveFault[slave - 1].store((ec_slave[slave].state != EC_STATE_OPERATIONAL) || ec_slave[slave].islost, std::memory_order_relaxed);
+                }
+
+                if (ec_slave[slave].state != EC_STATE_OPERATIONAL)
                 {
-                    ec_group[currentgroup].docheckstate = TRUE;
+                    ec_group[ec_slave[slave].group].docheckstate = TRUE;
                     if (ec_slave[slave].state == (EC_STATE_SAFE_OP + EC_STATE_ERROR))
                     {
-                        char buf[256];
-                        sprintf(buf, "EtherCAT Error: Slave %d is in SAFE_OP + ERROR, attempting ack.\n", slave);
-                        this->logger_->error(std::string(buf));
+                        this->logger_->error("EtherCAT Error: Slave {} is in SAFE_OP + ERROR, attempting ack.", slave);
 
                         ec_slave[slave].state = (EC_STATE_SAFE_OP + EC_STATE_ACK);
                         ec_writestate(slave);
@@ -398,9 +1493,7 @@ namespace bitbot
                     }
                     else if (ec_slave[slave].state == EC_STATE_SAFE_OP)
                     {
-                        char buf[256];
-                        sprintf(buf, "EtherCAT Status: Slave %d is in SAFE_OP, change to OPERATIONAL.\n", slave);
-                        this->logger_->info(std::string(buf));
+                        this->logger_->info("EtherCAT Status: Slave {} is in SAFE_OP, change to OPERATIONAL.", slave);
 
                         ec_slave[slave].state = EC_STATE_OPERATIONAL;
                         ec_writestate(slave);
@@ -411,9 +1504,7 @@ namespace bitbot
                         if (ec_reconfig_slave(slave, EC_TIMEOUTMON))
                         {
                             ec_slave[slave].islost = FALSE;
-                            char buf[256];
-                            sprintf(buf, "EtherCAT Status: Slave %d reconfigured\n", slave);
-                            this->logger_->info(std::string(buf));
+                            this->logger_->info("EtherCAT Status: Slave {} reconfigured", slave);
                         }
                     }
                     else if (!ec_slave[slave].islost)
@@ -423,9 +1514,7 @@ namespace bitbot
                         if (!ec_slave[slave].state)
                         {
                             ec_slave[slave].islost = TRUE;
-                            char buf[256];
-                            sprintf(buf, "EtherCAT Error: Slave %d lost\n", slave);
-                            this->logger_->error(std::string(buf));
+                            this->logger_->error("EtherCAT Error: Slave {} lost", slave);
                             err_count++;
                         }
                     }
@@ -437,25 +1526,33 @@ namespace bitbot
                         if (ec_recover_slave(slave, EC_TIMEOUTMON))
                         {
                             ec_slave[slave].islost = FALSE;
-                            char buf[256];
-                            sprintf(buf, "EtherCAT Status: Slave %d recovered\n", slave);
-                            this->logger_->info(std::string(buf));
+                            this->logger_->info("EtherCAT Status: Slave {} recovered", slave);
                         }
                     }
                     else
                     {
                         ec_slave[slave].islost = FALSE;
-                        char buf[256];
-                        sprintf(buf, "EtherCAT Status: Slave %d found\n", slave);
-                        this->logger_->info(std::string(buf));
+                        this->logger_->info("EtherCAT Status: Slave {} found", slave);
                     }
                 }
             }
-            if (!ec_group[currentgroup].docheckstate)
+            docheckstate = false;
+            for (size_t g = 0; g < K_MAX_GROUP; g++)
+            {
+                docheckstate |= this->GroupUsed[g] && ec_group[SoemGroup(g)].docheckstate;
+            }
+            if (!docheckstate)
             {
                 this->logger_->info("EtherCAT Status: All slaves resumed OPERATIONAL.");
             }
         }
+        else if (this->SlaveFault != nullptr)
+        {
+            for (int slave = 0; slave < ec_slavecount; slave++)
+            {
+                this->SlaveFault[slave].store(false, std::memory_order_relaxed);
+            }
+        }
     }
 
 };
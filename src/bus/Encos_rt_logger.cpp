@@ -0,0 +1,71 @@
+#include "bus/Encos_rt_logger.h"
+
+namespace bitbot
+{
+    EncosRtLogger::EncosRtLogger(size_t capacity)
+        : Queue(capacity)
+    {
+    }
+
+    EncosRtLogger::~EncosRtLogger()
+    {
+        this->Stop();
+    }
+
+    void EncosRtLogger::Start(SpdLoggerSharedPtr logger)
+    {
+        if (this->Worker.joinable())
+            return;
+        this->Logger = logger;
+        this->Running.store(true, std::memory_order_release);
+        this->Worker = std::thread(&EncosRtLogger::WorkerLoop, this);
+    }
+
+    void EncosRtLogger::Stop()
+    {
+        this->Running.store(false, std::memory_order_release);
+        if (this->Worker.joinable())
+            this->Worker.join();
+        this->Drain();
+    }
+
+    uint64_t EncosRtLogger::DroppedCount() const
+    {
+        return this->Dropped.load(std::memory_order_relaxed);
+    }
+
+    void EncosRtLogger::WorkerLoop()
+    {
+        while (this->Running.load(std::memory_order_acquire))
+        {
+            this->Drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(K_FLUSH_PERIOD_MS));
+        }
+    }
+
+    void EncosRtLogger::Drain()
+    {
+        EncosLogRecord record;
+        while (this->Queue.try_dequeue(record))
+        {
+            this->Write(record);
+        }
+
+        const uint64_t dropped = this->Dropped.load(std::memory_order_relaxed);
+        if (dropped != this->DroppedReported && this->Logger != nullptr)
+        {
+            this->Logger->warn("{} real-time log records dropped, {} in total.", dropped - this->DroppedReported, dropped);
+            this->DroppedReported = dropped;
+        }
+    }
+
+    void EncosRtLogger::Write(const EncosLogRecord& record)
+    {
+        if (this->Logger == nullptr || record.event == nullptr)
+            return;
+
+        // format errors are reported by the error handler of spdlog
+        const EncosLogArg* a = record.args;
+        this->Logger->log(record.event->level, fmt::runtime(record.event->format), a[0], a[1], a[2], a[3]);
+    }
+}
@@ -1,19 +1,37 @@
 #include "device/Encos_joint.h"
 #define _USE_MATH_DEFINES
 #include "cmath"
+#include "cstring"
 #include "math.h"
 #include "iostream"
 
 namespace bitbot
 {
 
-    union RV_TypeConvert
+    namespace
     {
-        float to_float;
-        int to_int;
-        unsigned int to_uint;
-        uint8_t buf[4];
-    };
+        // log events of the bus loop, formatted by the background thread of EncosRtLogger
+        constexpr EncosLogEvent K_LOG_NOT_POSITION_MODE{ spdlog::level::err, "Motor ID: {} is not in position mode or motion mode, command will be ignored!" };
+        constexpr EncosLogEvent K_LOG_NOT_VELOCITY_MODE{ spdlog::level::err, "Motor ID: {} is not in velocity mode or motion mode, command will be ignored!" };
+        constexpr EncosLogEvent K_LOG_NOT_TORQUE_MODE{ spdlog::level::err, "Motor ID: {} is not in torque mode or motion mode, command will be ignored!" };
+        constexpr EncosLogEvent K_LOG_NOT_MOTION_MODE{ spdlog::level::err, "Motor ID: {} is not in motion mode, command will be ignored!" };
+        constexpr EncosLogEvent K_LOG_MOTOR_FAULT{ spdlog::level::err, "Motor ID: {} receive error code: 0x{:02X}, {}." };
+        constexpr EncosLogEvent K_LOG_MOTOR_RECOVERED{ spdlog::level::info, "Motor ID: {} recovered from error code: 0x{:02X}, {}." };
+        constexpr EncosLogEvent K_LOG_SETTINGS_SUCCEED{ spdlog::level::info, "Motor ID: {} set command {} succeed." };
+        constexpr EncosLogEvent K_LOG_SETTINGS_FAILED{ spdlog::level::err, "Motor ID: {} set command {} failed." };
+        constexpr EncosLogEvent K_LOG_SETTINGS_TIMEOUT{ spdlog::level::err, "Motor ID: {} set command {} timed out." };
+        constexpr EncosLogEvent K_LOG_MOTOR_ONLINE{ spdlog::level::info, "Motor ID: {} is online." };
+        constexpr EncosLogEvent K_LOG_MOTOR_ID_RESET{ spdlog::level::warn, "Motor ID: {} is set to 1, however is strongly NOT recommend use motor reset command in Bitbot Encos!" };
+        constexpr EncosLogEvent K_LOG_AUTO_REPLY_MODE{ spdlog::level::warn, "Motor ID: {} is set in auto reply mode. however, it is strongly NOT recommend use motor auto reply mode in Bitbot Encos!" };
+        constexpr EncosLogEvent K_LOG_QUERY_REPLY_MODE{ spdlog::level::info, "Motor ID: {} is set in query reply mode." };
+        constexpr EncosLogEvent K_LOG_QUERY_FAILED{ spdlog::level::err, "Motor ID: {} receive code: 0x80, query failed." };
+        constexpr EncosLogEvent K_LOG_ZERO_SET{ spdlog::level::info, "Motor ID: {} sets current position as zero in {} cycle(s)." };
+        constexpr EncosLogEvent K_LOG_ZERO_TIMEOUT{ spdlog::level::warn, "Motor ID: {} received no zero point response in {} cycles, resume control." };
+        constexpr EncosLogEvent K_LOG_MOTOR_ID_UPDATED{ spdlog::level::info, "Motor ID: {} has been updated, remember to update the ID in Bitbot configuration file!" };
+        constexpr EncosLogEvent K_LOG_ALTERNATIVE_FAILED{ spdlog::level::err, "Motor ID: {} receive code: 0x00, command failed." };
+        constexpr EncosLogEvent K_LOG_ALTERNATIVE_UNKNOWN{ spdlog::level::err, "Motor ID: {} receive unknown command: {}" };
+        constexpr EncosLogEvent K_LOG_PARSE_COMMAND_FAILED{ spdlog::level::critical, "Motor ID: {} Parse Command Failed, fatel error, please report this bug to maintainers! Parser code: {}" };
+    }
 
     EncosJoint::EncosJoint(const pugi::xml_node &joint_node)
         : Encos_CANBusDevice(joint_node),
@@ -25,7 +43,7 @@ namespace bitbot
     {
         this->basic_type_ = static_cast<uint32_t>(BasicDeviceType::MOTOR);
         this->type_ = static_cast<uint32_t>(EncosDeviceType::Encos_JOINT);
-        monitor_header_.headers = {"status", "mode", "actual_position", "target_position", "actual_velocity", "target_velocity", "actual_current", "target_torque", "motor_temp", "driver_temp"};
+        monitor_header_.headers = {"status", "mode", "actual_position", "target_position", "actual_velocity", "target_velocity", "actual_current", "target_torque", "motor_temp", "driver_temp", "fault_code", "fault_latched"};
         monitor_data_.resize(monitor_header_.headers.size());
 
         std::string mode;
@@ -63,6 +81,35 @@ namespace bitbot
         ConfigParser::ParseAttribute2i(id, joint_node.attribute("slave_id"));
         this->Slave_ID__ = static_cast<decltype(this->Slave_ID__)>(id);
 
+        int can_channel = 0;
+        ConfigParser::ParseAttribute2i(can_channel, joint_node.attribute("can_channel"));
+        if (can_channel < 0 || can_channel > 2)
+        {
+            this->logger_->error("Unknown CAN channel {}, CAN channel can only be 1 or 2. Please check your xml file.", can_channel);
+            can_channel = 0;
+        }
+        this->CAN_Channel__ = static_cast<size_t>(can_channel);
+        this->CAN_Priority__ = 0;
+        ConfigParser::ParseAttribute2i(this->CAN_Priority__, joint_node.attribute("priority"));
+
+        int rate_div = 1;
+        ConfigParser::ParseAttribute2i(rate_div, joint_node.attribute("rate_div"));
+        if (rate_div < 1)
+        {
+            this->logger_->error("Invalid rate divider {}, rate divider must be greater than 0. Please check your xml file.", rate_div);
+            rate_div = 1;
+        }
+        this->CAN_RateDivider__ = static_cast<size_t>(rate_div);
+
+        int zero_timeout = 500;
+        ConfigParser::ParseAttribute2i(zero_timeout, joint_node.attribute("zero_timeout"));
+        if (zero_timeout < 1)
+        {
+            this->logger_->error("Invalid zero timeout {}, zero timeout must be greater than 0. Please check your xml file.", zero_timeout);
+            zero_timeout = 500;
+        }
+        this->ZeroTimeout__ = zero_timeout;
+
         int MotorDirection;
         double kp_range, kd_range, vel_range, pos_range, torque_range, current_range, KT;
         ConfigParser::ParseAttribute2i(MotorDirection, joint_node.attribute("motor_direction"));
@@ -234,8 +281,7 @@ namespace bitbot
         }
         else
         {
-            std::string msg = "Motor ID: " + std::to_string(this->id_) + " is not in position mode or motion mode, command will be ignored!";
-            this->logger_->error(msg);
+            this->LogControl(K_LOG_NOT_POSITION_MODE, this->id_);
         }
     }
 
@@ -265,8 +311,7 @@ namespace bitbot
         }
         else
         {
-            std::string msg = "Motor ID: " + std::to_string(this->id_) + " is not in velocity mode or motion mode, command will be ignored!";
-            this->logger_->error(msg);
+            this->LogControl(K_LOG_NOT_VELOCITY_MODE, this->id_);
         }
     }
 
@@ -290,8 +335,7 @@ namespace bitbot
         }
         else
         {
-            std::string msg = "Motor ID: " + std::to_string(this->id_) + " is not in torque mode or motion mode, command will be ignored!";
-            this->logger_->error(msg);
+            this->LogControl(K_LOG_NOT_TORQUE_MODE, this->id_);
         }
     }
 
@@ -302,14 +346,16 @@ namespace bitbot
             Position = std::clamp(Position, this->ConfigData__->POS_MIN, this->ConfigData__->POS_MAX);
             Velocity = std::clamp(Velocity, this->ConfigData__->SPD_MIN, this->ConfigData__->SPD_MAX);
             Torque = std::clamp(Torque, this->ConfigData__->T_MIN, this->ConfigData__->T_MAX);
+            this->RuntimeData__.TargetPosition.store(Position);
+            this->RuntimeData__.TargetVelocity.store(Velocity);
+            this->RuntimeData__.TargetTorque.store(Torque);
 
             if (!this->HighPriorityCommandWriting__.load()) // write this command only when high priority command is not writing the bus.
                 this->WriteCmdType__ = WriteCmdType_e::MOTION_CONTROL;
         }
         else
         {
-            std::string msg = "Motor ID: " + std::to_string(this->id_) + " is not in motion mode, command will be ignored!";
-            this->logger_->error(msg);
+            this->LogControl(K_LOG_NOT_MOTION_MODE, this->id_);
         }
     }
 
@@ -322,33 +368,131 @@ namespace bitbot
             this->WriteCmdType__ = WriteCmdType_e::CURRENT_CONTROL;
     }
 
-    // void EncosJoint::HotfixMotorAcceleration(float value)
-    // {
-    //     value = std::clamp(value, 0.0f, 20.0f);
-    //     this->RuntimeData__.SettingsAcc.store(value);
-    //     this->WriteCmdType__ = WriteCmdType_e::SETTINGS_MOTOR_ACC;
-    //     this->HighPriorityCommandWriting__.store(true);
-    // }
-
-    // void EncosJoint::HotfixMotorLinkageSpeedKI(float linkage, float KI)
-    // {
-    //     linkage = std::clamp(linkage, 0.0f, 1.0f);
-    //     KI = std::clamp(KI, 0.0f, 1.0f);
-    //     this->RuntimeData__.SettingsMagLinkGain.store(linkage);
-    //     this->RuntimeData__.SettingsDisturbComp.store(KI);
-    //     this->WriteCmdType__ = WriteCmdType_e::SETTINGS_LINK_COMP;
-    //     this->HighPriorityCommandWriting__.store(true);
-    // }
-
-    // void EncosJoint::HotfixMotorFeedbackKP_PD(float Kp, float Kd)
-    // {
-    //     Kp = std::clamp(Kp, 0.0f, 1.0f);
-    //     Kd = std::clamp(Kd, 0.0f, 1.0f);
-    //     this->RuntimeData__.Settings_FB_KP.store(Kp);
-    //     this->RuntimeData__.Settings_FB_KD.store(Kd);
-    //     this->WriteCmdType__ = WriteCmdType_e::SETTINGS_FB_KD;
-    //     this->HighPriorityCommandWriting__.store(true);
-    // }
+    EncosConfigHandle EncosJoint::HotfixMotorAcceleration(float value)
+    {
+        value = std::clamp(value, 0.0f, 20.0f);
+        return this->SubmitConfig(0x01, value, 0);
+    }
+
+    EncosConfigHandle EncosJoint::HotfixMotorLinkageSpeedKI(float linkage, float KI)
+    {
+        linkage = std::clamp(linkage, 0.0f, 1.0f);
+        KI = std::clamp(KI, 0.0f, 1.0f);
+        return this->SubmitConfig(0x02, linkage, KI);
+    }
+
+    EncosConfigHandle EncosJoint::HotfixMotorFeedbackKP_PD(float Kp, float Kd)
+    {
+        Kp = std::clamp(Kp, 0.0f, 1.0f);
+        Kd = std::clamp(Kd, 0.0f, 1.0f);
+        return this->SubmitConfig(0x03, Kp, Kd);
+    }
+
+    EncosConfigStatus EncosConfigHandle::Status() const
+    {
+        if (this->joint == nullptr || this->ticket == 0)
+            return EncosConfigStatus::Rejected;
+        return this->joint->GetConfigStatus(this->ticket);
+    }
+
+    bool EncosConfigHandle::Done() const
+    {
+        const EncosConfigStatus status = this->Status();
+        return status != EncosConfigStatus::Pending && status != EncosConfigStatus::Sent;
+    }
+
+    EncosConfigHandle EncosJoint::SubmitConfig(uint8_t code, float value0, float value1)
+    {
+        constexpr uint32_t ticket_mask = 0x0FFFFFFF; // 28 bits, the low 4 bits of a status record hold the status
+        uint32_t ticket = (this->ConfigTicket__ + 1) & ticket_mask;
+        if (ticket == 0)
+            ticket = 1;
+
+        std::atomic<uint32_t>& record = this->ConfigStatus__[ticket % K_CONFIG_STATUS_NUM];
+        uint32_t previous = record.load(std::memory_order_relaxed);
+        if (!this->ConfigQueue__.try_enqueue(EncosJointConfigCommand{ code, value0, value1, ticket }))
+            return EncosConfigHandle(this, 0);
+
+        // the bus thread may have sent the command already, a newer status must not be overwritten
+        record.compare_exchange_strong(previous, (ticket << 4) | static_cast<uint32_t>(EncosConfigStatus::Pending), std::memory_order_release, std::memory_order_relaxed);
+        this->ConfigTicket__ = ticket;
+        return EncosConfigHandle(this, ticket);
+    }
+
+    void EncosJoint::SetConfigStatus(uint32_t ticket, EncosConfigStatus status)
+    {
+        this->ConfigStatus__[ticket % K_CONFIG_STATUS_NUM].store((ticket << 4) | static_cast<uint32_t>(status), std::memory_order_release);
+    }
+
+    EncosConfigStatus EncosJoint::GetConfigStatus(uint32_t ticket) const
+    {
+        const uint32_t record = this->ConfigStatus__[ticket % K_CONFIG_STATUS_NUM].load(std::memory_order_acquire);
+        if ((record >> 4) != ticket)
+            return EncosConfigStatus::Expired;
+        return static_cast<EncosConfigStatus>(record & 0xF);
+    }
+
+    uint64_t EncosJoint::BusCycle() const
+    {
+        return (this->BusCycle__ != nullptr) ? *this->BusCycle__ : 0;
+    }
+
+    bool EncosJoint::WriteBusConfig(CAN_Device_Msg &data)
+    {
+        const uint64_t cycle = this->BusCycle();
+        if (this->ConfigInFlight__.ticket != 0)
+        {
+            if (cycle < this->ConfigDeadline__) [[likely]]
+                return false;
+            this->SetConfigStatus(this->ConfigInFlight__.ticket, EncosConfigStatus::TimedOut);
+            this->Log(K_LOG_SETTINGS_TIMEOUT, this->id_, this->ConfigInFlight__.code);
+            this->ConfigInFlight__.ticket = 0;
+        }
+
+        if (cycle < this->ConfigNextSend__ || !this->ConfigQueue__.try_dequeue(this->ConfigInFlight__)) [[likely]]
+            return false;
+
+        this->WriteBusSettings(data, this->ConfigInFlight__);
+        this->SetConfigStatus(this->ConfigInFlight__.ticket, EncosConfigStatus::Sent);
+        this->ConfigDeadline__ = cycle + K_CONFIG_TIMEOUT;
+        this->ConfigNextSend__ = cycle + K_CONFIG_INTERVAL;
+        return true;
+    }
+
+    void EncosJoint::ProcessConfigAck(uint32_t code, bool succeed)
+    {
+        EncosJointConfigCommand& cmd = this->ConfigInFlight__;
+        if (cmd.ticket != 0 && cmd.code == code)
+        {
+            if (succeed)
+            {
+                // keep the values the motor is running with
+                switch (cmd.code)
+                {
+                case 0x01:
+                    this->RuntimeData__.SettingsAcc.store(cmd.value0);
+                    break;
+                case 0x02:
+                    this->RuntimeData__.SettingsMagLinkGain.store(cmd.value0);
+                    this->RuntimeData__.SettingsDisturbComp.store(cmd.value1);
+                    break;
+                case 0x03:
+                    this->RuntimeData__.Settings_FB_KP.store(cmd.value0);
+                    this->RuntimeData__.Settings_FB_KD.store(cmd.value1);
+                    break;
+                default:
+                    break;
+                }
+            }
+            this->SetConfigStatus(cmd.ticket, succeed ? EncosConfigStatus::Succeeded : EncosConfigStatus::Failed);
+            cmd.ticket = 0;
+        }
+
+        if (succeed)
+            this->Log(K_LOG_SETTINGS_SUCCEED, this->id_, code);
+        else
+            this->Log(K_LOG_SETTINGS_FAILED, this->id_, code);
+    }
 
     void EncosJoint::ResetMotorPosition()
     {
@@ -357,59 +501,193 @@ namespace bitbot
         this->HighPriorityCommandWriting__.store(true);
     }
 
+    bool EncosJoint::isResettingPosition()
+    {
+        return this->ZeroPending__.load();
+    }
+
+    namespace
+    {
+        // raw monitor state of a joint, captured in the kernel loop and converted in the monitor thread
+        struct JointMonitorSample
+        {
+            float status;
+            uint32_t mode;
+            float current_position;
+            float target_position;
+            float current_velocity;
+            float target_velocity;
+            float current_current;
+            float target_torque;
+            float motor_temperature;
+            float driver_temperature;
+            uint32_t fault_code;
+            uint32_t fault_latched;
+        };
+        constexpr size_t K_JOINT_MONITOR_WORDS = sizeof(JointMonitorSample) / sizeof(uint32_t);
+        static_assert(sizeof(JointMonitorSample) % sizeof(uint32_t) == 0);
+    }
+
     void EncosJoint::UpdateRuntimeData()
     {
-        constexpr float r2d = 180.0f / M_PI;
+        uint32_t sample[K_JOINT_MONITOR_WORDS];
+        this->CaptureMonitorSample(sample);
+        this->UpdateMonitorData(sample);
+    }
+
+    size_t EncosJoint::MonitorSampleWords() const
+    {
+        return K_JOINT_MONITOR_WORDS;
+    }
 
+    void EncosJoint::CaptureMonitorSample(uint32_t* sample) const
+    {
+        JointMonitorSample s;
         if (this->Enable__)
         {
-            this->monitor_data_[0] = (this->PowerOn__ == true) ? 1.0 : 0.0;
+            s.status = (this->PowerOn__ == true) ? 1.0f : 0.0f;
         }
         else
         {
-            this->monitor_data_[0] = -1.0;
+            s.status = -1.0f;
+        }
+
+        s.mode = static_cast<uint32_t>(this->JointMode__);
+        s.current_position = this->RuntimeData__.CurrentPosition.load();
+        s.target_position = this->RuntimeData__.TargetPosition.load();
+        s.current_velocity = this->RuntimeData__.CurrentVelocity.load();
+        s.target_velocity = this->RuntimeData__.TargetVelocity.load();
+        s.current_current = this->RuntimeData__.CurrentCurrent.load();
+        s.target_torque = this->RuntimeData__.TargetTorque.load();
+        s.motor_temperature = this->RuntimeData__.MotorTemperature.load();
+        s.driver_temperature = this->RuntimeData__.DriverTemperature.load();
+        s.fault_code = this->Fault__.active_code.load(std::memory_order_relaxed);
+        s.fault_latched = this->Fault__.latched.load(std::memory_order_relaxed);
+        std::memcpy(sample, &s, sizeof(s));
+    }
+
+    void EncosJoint::UpdateMonitorData(const uint32_t* sample)
+    {
+        constexpr float r2d = 180.0f / M_PI;
+
+        JointMonitorSample s;
+        std::memcpy(&s, sample, sizeof(s));
+        this->monitor_data_[0] = static_cast<double>(s.status);
+        this->monitor_data_[1] = static_cast<uint8_t>(s.mode);
+        this->monitor_data_[2] = s.current_position * r2d;
+        this->monitor_data_[3] = s.target_position * r2d;
+        this->monitor_data_[4] = s.current_velocity;
+        this->monitor_data_[5] = s.target_velocity;
+        this->monitor_data_[6] = s.current_current;
+        this->monitor_data_[7] = s.target_torque;
+        this->monitor_data_[8] = s.motor_temperature;
+        this->monitor_data_[9] = s.driver_temperature;
+        this->monitor_data_[10] = static_cast<uint8_t>(s.fault_code);
+        this->monitor_data_[11] = s.fault_latched;
+    }
+
+    namespace
+    {
+        // error codes reported by the motor which are not faults
+        constexpr bool IsMotorFault(uint8_t code)
+        {
+            return code != 0x00 && code != 0x05;
         }
 
-        this->monitor_data_[1] = static_cast<uint8_t>(this->JointMode__);
-        this->monitor_data_[2] = this->RuntimeData__.CurrentPosition.load() * r2d;
-        this->monitor_data_[3] = this->RuntimeData__.TargetPosition.load() * r2d;
-        this->monitor_data_[4] = this->RuntimeData__.CurrentVelocity.load();
-        this->monitor_data_[5] = this->RuntimeData__.TargetVelocity.load();
-        this->monitor_data_[6] = this->RuntimeData__.CurrentCurrent.load();
-        this->monitor_data_[7] = this->RuntimeData__.TargetTorque.load();
-        this->monitor_data_[8] = this->RuntimeData__.MotorTemperature.load();
-        this->monitor_data_[9] = this->RuntimeData__.DriverTemperature.load();
+        constexpr const char* MotorFaultDescription(uint8_t code)
+        {
+            switch (code)
+            {
+            case 0x01:
+                return "motor over temperature";
+            case 0x02:
+                return "motor over current";
+            case 0x03:
+                return "motor under voltage";
+            case 0x04:
+                return "motor encoder error";
+            case 0x06:
+                return "motor break voltage too high";
+            case 0x07:
+                return "motor driver error";
+            default:
+                return "unknown error";
+            }
+        }
     }
 
     void EncosJoint::ProcessErrorCode(uint8_t error_code)
     {
-        switch (error_code)
+        MotorFaultStatistics& fault = this->Fault__;
+        const uint8_t code = error_code & (MotorFaultStatistics::K_CODE_NUM - 1);
+        const uint64_t cycle = (this->BusCycle__ != nullptr) ? *this->BusCycle__ : 0;
+        if (code != 0x00) [[unlikely]]
         {
-        case 0x00:
-            break;
-        case 0x01:
-            this->logger_->error(std::string("Motor ID: ") + std::to_string(this->id_) + " receive error code: 0x01, motor over temperature.");
-            break;
-        case 0x02:
-            this->logger_->error(std::string("Motor ID: ") + std::to_string(this->id_) + " receive error code: 0x02, motor over current.");
-            break;
-        case 0x03:
-            this->logger_->error(std::string("Motor ID: ") + std::to_string(this->id_) + " receive error code: 0x03, motor under voltage.");
-            break;
-        case 0x04:
-            this->logger_->error(std::string("Motor ID: ") + std::to_string(this->id_) + " receive error code: 0x04, motor encoder error.");
-            break;
-        case 0x05:
-            break;
-        case 0x06:
-            this->logger_->error(std::string("Motor ID: ") + std::to_string(this->id_) + " receive error code: 0x06, motor break voltage too high.");
-            break;
-        case 0x07:
-            this->logger_->error(std::string("Motor ID: ") + std::to_string(this->id_) + " receive error code: 0x07, motor driver error.");
-            break;
-        default:
-            this->logger_->error(std::string("Motor ID: ") + std::to_string(this->id_) + " receive error code: " + std::to_string(error_code) + ", unknown error.");
-            break;
+            if (fault.count[code]++ == 0)
+                fault.first_cycle[code] = cycle;
+            fault.last_cycle[code] = cycle;
+        }
+
+        // only the bus thread writes the error code
+        const uint8_t previous = fault.active_code.load(std::memory_order_relaxed);
+        if (code == previous) [[likely]]
+            return;
+
+        // only a change of the error code is logged, a lasting fault is counted silently
+        fault.active_code.store(code, std::memory_order_relaxed);
+        if (code != 0x00)
+            fault.onset[code]++;
+
+        if (IsMotorFault(code))
+        {
+            fault.latched.fetch_or(uint32_t(1) << code, std::memory_order_relaxed);
+            this->Log(K_LOG_MOTOR_FAULT, this->id_, code, MotorFaultDescription(code));
+        }
+        else if (IsMotorFault(previous))
+        {
+            this->Log(K_LOG_MOTOR_RECOVERED, this->id_, previous, MotorFaultDescription(previous));
+        }
+    }
+
+    const MotorFaultStatistics& EncosJoint::GetFaultStatistics() const
+    {
+        return this->Fault__;
+    }
+
+    bool EncosJoint::HasFault() const
+    {
+        return IsMotorFault(this->Fault__.active_code.load(std::memory_order_relaxed));
+    }
+
+    void EncosJoint::ClearFaults()
+    {
+        this->Fault__.latched.store(0, std::memory_order_relaxed);
+    }
+
+    size_t EncosJoint::JointIndex() const
+    {
+        return this->JointIndex__;
+    }
+
+    void EncosJoint::StoreState(float position, float velocity, float current, float motor_temp, float driver_temp)
+    {
+        // the values are independent of each other, relaxed stores avoid a full fence per value
+        this->RuntimeData__.CurrentPosition.store(position, std::memory_order_relaxed);
+        this->RuntimeData__.CurrentVelocity.store(velocity, std::memory_order_relaxed);
+        this->RuntimeData__.CurrentCurrent.store(current, std::memory_order_relaxed);
+        this->RuntimeData__.MotorTemperature.store(motor_temp, std::memory_order_relaxed);
+        this->RuntimeData__.DriverTemperature.store(driver_temp, std::memory_order_relaxed);
+
+        if (this->StateTable__ != nullptr)
+        {
+            JointStateTable& table = *this->StateTable__;
+            const size_t i = this->JointIndex__;
+            table.position[i] = position;
+            table.velocity[i] = velocity;
+            table.current[i] = current;
+            table.torque[i] = current * this->ConfigData__->KT;
+            table.motor_temperature[i] = motor_temp;
+            table.driver_temperature[i] = driver_temp;
         }
     }
 
@@ -420,87 +698,54 @@ namespace bitbot
 
         if (data.id == this->id_) [[likely]]
         {
-            int ack_status = data.data[0] >> 5;
-            uint8_t error_code = data.data[0] & 0x1F;
+            using namespace EncosFrame;
+            const uint64_t word = ReplyType1::Layout::Load(data);
+            const uint32_t ack_status = ReplyHeader::AckType::Get(word);
+            const uint8_t error_code = static_cast<uint8_t>(ReplyHeader::ErrorCode::Get(word));
             this->ProcessErrorCode(error_code);
 
-            int pos_int = 0;
-            int spd_int = 0;
-            int cur_int = 0;
-
             constexpr float deg2rad = M_PI / 180;
             constexpr float rpm2rads = 2 * M_PI / 60;
+            const MotorConigurationData* cfg = this->ConfigData__;
 
             switch (ack_status)
             {
             case 1:
             {
-                pos_int = data.data[1] << 8 | data.data[2];
-                spd_int = data.data[3] << 4 | (data.data[4] & 0xF0) >> 4;
-                cur_int = (data.data[4] & 0x0F) << 8 | data.data[5];
-                float angle = this->uint_to_float(pos_int, this->ConfigData__->POS_MIN, this->ConfigData__->POS_MAX, 16) * this->ConfigData__->MOTOR_DIRECTION;
-                float vel = this->uint_to_float(spd_int, this->ConfigData__->SPD_MIN, this->ConfigData__->SPD_MAX, 12) * this->ConfigData__->MOTOR_DIRECTION;
-                float current = this->uint_to_float(cur_int, this->ConfigData__->I_MIN, this->ConfigData__->I_MAX, 12) * this->ConfigData__->MOTOR_DIRECTION;
-                float motor_temp = (static_cast<float>(data.data[6] - 50)) / 2.0;
-                float mos_temp = (static_cast<float>(data.data[7] - 50)) / 2.0;
-
-                this->RuntimeData__.CurrentPosition.store(angle);
-                this->RuntimeData__.CurrentVelocity.store(vel);
-                this->RuntimeData__.CurrentCurrent.store(current);
-                this->RuntimeData__.MotorTemperature.store(motor_temp);
-                this->RuntimeData__.DriverTemperature.store(mos_temp);
+                const float direction = static_cast<float>(cfg->MOTOR_DIRECTION);
+                this->StoreState(cfg->POS_SCALE.Decode(ReplyType1::Position::Get(word)) * direction,
+                    cfg->SPD_SCALE.Decode(ReplyType1::Velocity::Get(word)) * direction,
+                    cfg->I_SCALE.Decode(ReplyType1::Current::Get(word)) * direction,
+                    DecodeTemperature(ReplyType1::MotorTemperature::Get(word)),
+                    DecodeTemperature(ReplyType1::DriverTemperature::Get(word)));
                 break;
             }
 
             case 2:
             {
-                RV_TypeConvert rv_type_convert;
-                rv_type_convert.buf[0] = data.data[4];
-                rv_type_convert.buf[1] = data.data[3];
-                rv_type_convert.buf[2] = data.data[2];
-                rv_type_convert.buf[3] = data.data[1];
-                float pos = rv_type_convert.to_float * deg2rad * this->ConfigData__->MOTOR_DIRECTION;
-                int16_t cur_int = data.data[5] << 8 | data.data[6];
-
-                this->RuntimeData__.CurrentPosition.store(pos);
-                this->RuntimeData__.CurrentCurrent.store(static_cast<float>(cur_int) / 100.0f * this->ConfigData__->MOTOR_DIRECTION);
-                this->RuntimeData__.CurrentVelocity.store(0);
-                this->RuntimeData__.DriverTemperature.store(0);
-                this->RuntimeData__.MotorTemperature.store((data.data[7] - 50.0) / 2.0);
+                const float pos = std::bit_cast<float>(ReplyType2::Value::Get(word)) * deg2rad * cfg->MOTOR_DIRECTION;
+                const int16_t cur_int = static_cast<int16_t>(ReplyType2::Current::Get(word));
+
+                this->StoreState(pos, 0, static_cast<float>(cur_int) / 100.0f * cfg->MOTOR_DIRECTION,
+                    DecodeTemperature(ReplyType2::MotorTemperature::Get(word)), 0);
                 break;
             }
 
             case 3:
             {
-                RV_TypeConvert rv_type_convert;
-                rv_type_convert.buf[0] = data.data[4];
-                rv_type_convert.buf[1] = data.data[3];
-                rv_type_convert.buf[2] = data.data[2];
-                rv_type_convert.buf[3] = data.data[1];
-                float vel = rv_type_convert.to_float * rpm2rads * this->ConfigData__->MOTOR_DIRECTION;
-                int16_t cur_int = data.data[5] << 8 | data.data[6];
-
-                this->RuntimeData__.CurrentPosition.store(0);
-                this->RuntimeData__.CurrentCurrent.store(static_cast<float>(cur_int) / 100.0f * this->ConfigData__->MOTOR_DIRECTION);
-                this->RuntimeData__.CurrentVelocity.store(vel);
-                this->RuntimeData__.DriverTemperature.store(0);
-                this->RuntimeData__.MotorTemperature.store((data.data[7] - 50.0) / 2.0);
+                const float vel = std::bit_cast<float>(ReplyType2::Value::Get(word)) * rpm2rads * cfg->MOTOR_DIRECTION;
+                const int16_t cur_int = static_cast<int16_t>(ReplyType2::Current::Get(word));
+
+                this->StoreState(0, vel, static_cast<float>(cur_int) / 100.0f * cfg->MOTOR_DIRECTION,
+                    DecodeTemperature(ReplyType2::MotorTemperature::Get(word)), 0);
                 break;
             }
             case 4:
             {
-                if (data.dlc != 3)
+                if (data.dlc != ReplyType4::Layout::dlc)
                     return;
-                if (data.data[2] == 0x01)
-                {
-                    std::string msg = "Motor ID: " + std::to_string(this->id_) + " set command " + std::to_string(data.data[1]) + " succeed.";
-                    this->logger_->info(msg);
-                }
-                else
-                {
-                    std::string msg = "Motor ID: " + std::to_string(this->id_) + " set command " + std::to_string(data.data[1]) + " failed.";
-                    this->logger_->error(msg);
-                }
+                this->ProcessConfigAck(ReplyType4::Code::Get(word), ReplyType4::Result::Get(word) == 0x01);
+                break;
             }
             case 5:
                 // TODO: add unpack code for message 5
@@ -521,8 +766,7 @@ namespace bitbot
                 uint16_t motor_id = data.data[3] << 8 | data.data[4];
                 if (motor_id == this->id_)
                 {
-                    std::string msg = "Motor ID: " + std::to_string(motor_id) + " is online.";
-                    this->logger_->info(msg);
+                    this->Log(K_LOG_MOTOR_ONLINE, motor_id);
                 }
             }
             else if ((data.data[0] == 0x80) && (data.data[1] == 0x80)) // inquire failed
@@ -531,8 +775,7 @@ namespace bitbot
             }
             else if ((data.data[0] == 0x7F) && (data.data[1] == 0x7F)) // reset ID succeed
             {
-                std::string msg = "Motor ID: " + std::to_string(this->id_) + " is set to 1, however is strongly NOT recommend use motor reset command in Bitbot Encos!";
-                this->logger_->warn(msg);
+                this->Log(K_LOG_MOTOR_ID_RESET, this->id_);
             }
             else
             {
@@ -544,50 +787,43 @@ namespace bitbot
                     {
                     case 0x01:
                     {
-                        std::string msg = "Motor ID: " + std::to_string(motor_id) + " is set in auto reply mode. however, it is strongly NOT recommend use motor auto reply mode in Bitbot Encos!";
-                        this->logger_->warn(msg);
+                        this->Log(K_LOG_AUTO_REPLY_MODE, motor_id);
                         break;
                     }
                     case 0x02:
                     {
-                        std::string msg = "Motor ID: " + std::to_string(motor_id) + " is set in query reply mode.";
-                        this->logger_->info(msg);
+                        this->Log(K_LOG_QUERY_REPLY_MODE, motor_id);
                         break;
                     }
                     case 0x80:
                     {
-                        std::string msg = "Motor ID: " + std::to_string(motor_id) + " receive code: 0x80, query failed.";
-                        this->logger_->error(msg);
+                        this->Log(K_LOG_QUERY_FAILED, motor_id);
                         break;
                     }
                     case 0x03:
                     {
-                        static std::chrono::high_resolution_clock::time_point last_call;
-                        std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-                        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_call).count() > 1000)
+                        // the motor has written the zero point, the bus is released at once instead of waiting for the timeout
+                        if (this->ZeroPending__.load())
                         {
-                            std::string msg = "Motor ID: " + std::to_string(motor_id) + " sets current position as zero.";
-                            this->logger_->info(msg);
+                            this->ZeroPending__.store(false);
+                            this->isConfig__ = 0;
+                            this->Log(K_LOG_ZERO_SET, motor_id, this->BusCycle() - this->ZeroStartCycle__);
                         }
-                        last_call = now;
                         break;
                     }
                     case 0x04:
                     {
-                        std::string msg = "Motor ID: " + std::to_string(motor_id) + " has been updated, remember to update the ID in Bitbot configuration file!";
-                        this->logger_->info(msg);
+                        this->Log(K_LOG_MOTOR_ID_UPDATED, motor_id);
                         break;
                     }
                     case 0x00:
                     {
-                        std::string msg = "Motor ID: " + std::to_string(motor_id) + " receive code: 0x00， command failed.";
-                        this->logger_->error(msg);
+                        this->Log(K_LOG_ALTERNATIVE_FAILED, motor_id);
                         break;
                     }
                     default:
                     {
-                        std::string msg = "Motor ID: " + std::to_string(motor_id) + " receive unknown command: " + std::to_string(motor_fbd);
-                        this->logger_->error(msg);
+                        this->Log(K_LOG_ALTERNATIVE_UNKNOWN, motor_id, motor_fbd);
                     }
                     break;
                     }
@@ -629,18 +865,23 @@ namespace bitbot
 
     void EncosJoint::WriteBus(CAN_Device_Msg &data)
     {
-        constexpr uint32_t CFG_BUS_WAIT = 500;
-
         this->HighPriorityCommandWriting__.store(false);
         if (this->isConfig__ == 0) [[likely]]
         {
             data.id = this->id_;
-            switch (this->WriteCmdType__.load())
+            const WriteCmdType_e cmd_type = this->WriteCmdType__.load();
+            // settings frames are interleaved between control frames, high priority commands go first
+            if (cmd_type >= WriteCmdType_e::MOTION_CONTROL && this->WriteBusConfig(data))
+                return;
+
+            switch (cmd_type)
             {
             case WriteCmdType_e::SET_ZERO:
             {
                 this->WriteBusSetZero(data);
-                this->isConfig__ = CFG_BUS_WAIT;
+                this->isConfig__ = this->ZeroTimeout__;
+                this->ZeroStartCycle__ = this->BusCycle();
+                this->ZeroPending__.store(true);
                 this->ShiftCommand();
                 this->RuntimeData__.TargetTorque.store(0);
                 this->RuntimeData__.TargetVelocity.store(0);
@@ -684,28 +925,9 @@ namespace bitbot
                 this->WriteBusSetMotorCurrentControl(data);
                 break;
             }
-            case WriteCmdType_e::SETTINGS_MOTOR_ACC:
-            {
-                this->WriteBusSettingsMotorAcc(data);
-                this->ShiftCommand();
-                break;
-            }
-            case WriteCmdType_e::SETTINGS_LINK_COMP:
-            {
-                this->WriteBusSettingsLinkComp(data);
-                this->ShiftCommand();
-                break;
-            }
-            case WriteCmdType_e::SETTINGS_FB_KD:
-            {
-                this->WriteBusSettings_FB_KD(data);
-                this->ShiftCommand();
-                break;
-            }
             default:
             {
-                std::string msg = "Motor ID: " + std::to_string(this->id_) + " Parse Command Failed, fatel error, please report this bug to maintainers! Parser code: " + std::to_string(static_cast<uint32_t>(this->WriteCmdType__.load()));
-                this->logger_->critical(msg);
+                this->Log(K_LOG_PARSE_COMMAND_FAILED, this->id_, static_cast<uint32_t>(this->WriteCmdType__.load()));
             }
             }
         }
@@ -718,6 +940,11 @@ namespace bitbot
                 data.data[i] = 0;
             }
             this->isConfig__--;
+            if (this->isConfig__ == 0 && this->ZeroPending__.load()) [[unlikely]]
+            {
+                this->ZeroPending__.store(false);
+                this->Log(K_LOG_ZERO_TIMEOUT, this->id_, this->ZeroTimeout__);
+            }
         }
     }
     size_t EncosJoint::get_EtherCAT_Slave_ID() const
@@ -732,50 +959,36 @@ namespace bitbot
         ids[1] = this->Alternative_ID__;
     }
 
-    uint EncosJoint::float_to_uint(float x, float x_min, float x_max, int bits)
+    size_t EncosJoint::get_CAN_Channel() const
     {
-        /// Converts a float to an unsigned int, given range and number of bits ///
-        float span = x_max - x_min;
-        float offset = x_min;
-        return (uint)((x - offset) * ((float)((1 << bits) - 1)) / span);
+        return this->CAN_Channel__;
     }
 
-    float EncosJoint::uint_to_float(uint x_int, float x_min, float x_max, int bits)
+    int EncosJoint::get_CAN_Priority() const
     {
-        /// converts unsigned int to float, given range and number of bits ///
-        float span = x_max - x_min;
-        float offset = x_min;
-        return ((float)x_int) * span / ((float)((1 << bits) - 1)) + offset;
+        return this->CAN_Priority__;
+    }
+
+    size_t EncosJoint::get_CAN_RateDivider() const
+    {
+        return this->CAN_RateDivider__;
     }
 
     void EncosJoint::WriteBusSetMotorMotionControl(CAN_Device_Msg &data)
     {
         if (this->Enable__ && this->PowerOn__)
         {
-            data.dlc = 8;
-            data.rtr = 0;
             data.id = this->id_;
 
-            int kp_int;
-            int kd_int;
-            int pos_int;
-            int spd_int;
-            int tor_int;
-
-            kp_int = this->float_to_uint(this->RuntimeData__.Kp.load(), this->ConfigData__->KP_MIN, this->ConfigData__->KP_MAX, 12);
-            kd_int = this->float_to_uint(this->RuntimeData__.Kd.load(), this->ConfigData__->KD_MIN, this->ConfigData__->KD_MAX, 9);
-            pos_int = this->float_to_uint(this->RuntimeData__.TargetPosition.load() * this->ConfigData__->MOTOR_DIRECTION, this->ConfigData__->POS_MIN, this->ConfigData__->POS_MAX, 16);
-            spd_int = this->float_to_uint(this->RuntimeData__.TargetVelocity.load() * this->ConfigData__->MOTOR_DIRECTION, this->ConfigData__->SPD_MIN, this->ConfigData__->SPD_MAX, 12);
-            tor_int = this->float_to_uint(this->RuntimeData__.TargetTorque.load() * this->ConfigData__->MOTOR_DIRECTION, this->ConfigData__->T_MIN, this->ConfigData__->T_MAX, 12);
-
-            data.data[0] = 0x00 | (kp_int >> 7);                             // kp5
-            data.data[1] = ((kp_int & 0x7F) << 1) | ((kd_int & 0x100) >> 8); // kp7+kd1
-            data.data[2] = kd_int & 0xFF;
-            data.data[3] = pos_int >> 8;
-            data.data[4] = pos_int & 0xFF;
-            data.data[5] = spd_int >> 4;
-            data.data[6] = (spd_int & 0x0F) << 4 | (tor_int >> 8);
-            data.data[7] = tor_int & 0xff;
+            using Frame = EncosFrame::MotionCommand;
+            const MotorConigurationData* cfg = this->ConfigData__;
+            const float direction = static_cast<float>(cfg->MOTOR_DIRECTION);
+            Frame::Layout::Pack(data, Frame::header,
+                cfg->KP_SCALE.Encode(this->RuntimeData__.Kp.load()),
+                cfg->KD_SCALE.Encode(this->RuntimeData__.Kd.load()),
+                cfg->POS_SCALE.Encode(this->RuntimeData__.TargetPosition.load() * direction),
+                cfg->SPD_SCALE.Encode(this->RuntimeData__.TargetVelocity.load() * direction),
+                cfg->T_SCALE.Encode(this->RuntimeData__.TargetTorque.load() * direction));
         }
         else
         {
@@ -787,27 +1000,19 @@ namespace bitbot
     {
         if (this->Enable__ && this->PowerOn__)
         {
-            data.rtr = 0;
-            data.dlc = 8;
             data.id = this->id_;
 
             constexpr float r2d = 180.0f / M_PI;
             constexpr float rads2rpm = 60.0f / (2 * M_PI);
-            RV_TypeConvert rv_type_convert;
-            rv_type_convert.to_float = this->RuntimeData__.TargetPosition.load() * this->ConfigData__->MOTOR_DIRECTION * r2d;
-            float vel = std::abs(this->RuntimeData__.TargetVelocity.load()) * rads2rpm;
-            uint16_t spd = static_cast<uint16_t>(vel * 10.0f);
-            uint16_t cur = static_cast<uint16_t>(this->RuntimeData__.CurrentLimit.load() * 10.0f);
-            uint16_t ack_status = 1;
-
-            data.data[0] = 0x20 | (rv_type_convert.buf[3] >> 3);
-            data.data[1] = (rv_type_convert.buf[3] << 5) | (rv_type_convert.buf[2] >> 3);
-            data.data[2] = (rv_type_convert.buf[2] << 5) | (rv_type_convert.buf[1] >> 3);
-            data.data[3] = (rv_type_convert.buf[1] << 5) | (rv_type_convert.buf[0] >> 3);
-            data.data[4] = (rv_type_convert.buf[0] << 5) | (spd >> 10);
-            data.data[5] = (spd & 0x3FC) >> 2;
-            data.data[6] = (spd & 0x03) << 6 | (cur >> 6);
-            data.data[7] = (cur & 0x3F) << 2 | ack_status;
+            constexpr uint32_t ack_status = 1;
+            using Frame = EncosFrame::PositionCommand;
+            const float pos = this->RuntimeData__.TargetPosition.load() * this->ConfigData__->MOTOR_DIRECTION * r2d;
+            const float vel = std::abs(this->RuntimeData__.TargetVelocity.load()) * rads2rpm;
+            Frame::Layout::Pack(data, Frame::header,
+                std::bit_cast<uint32_t>(pos),
+                EncosSaturateUInt(vel * 10.0f, Frame::Velocity::max),
+                EncosSaturateUInt(this->RuntimeData__.CurrentLimit.load() * 10.0f, Frame::Current::max),
+                ack_status);
         }
         else
         {
@@ -819,23 +1024,15 @@ namespace bitbot
     {
         if (this->Enable__ && this->PowerOn__)
         {
-            data.rtr = 0;
-            data.dlc = 7;
             data.id = this->id_;
 
             constexpr float rads2rpm = 60.0f / (2 * M_PI);
-            RV_TypeConvert rv_type_convert;
-            rv_type_convert.to_float = this->RuntimeData__.TargetVelocity.load() * this->ConfigData__->MOTOR_DIRECTION * rads2rpm;
-            uint16_t cur = static_cast<uint16_t>(this->RuntimeData__.CurrentLimit.load() * 10.0f);
-            uint16_t ack_status = 1;
-
-            data.data[0] = 0x40 | ack_status;
-            data.data[1] = rv_type_convert.buf[3];
-            data.data[2] = rv_type_convert.buf[2];
-            data.data[3] = rv_type_convert.buf[1];
-            data.data[4] = rv_type_convert.buf[0];
-            data.data[5] = cur >> 8;
-            data.data[6] = cur & 0xff;
+            constexpr uint32_t ack_status = 1;
+            using Frame = EncosFrame::VelocityCommand;
+            const float vel = this->RuntimeData__.TargetVelocity.load() * this->ConfigData__->MOTOR_DIRECTION * rads2rpm;
+            Frame::Layout::Pack(data, Frame::header, 0, ack_status,
+                std::bit_cast<uint32_t>(vel),
+                EncosSaturateUInt(this->RuntimeData__.CurrentLimit.load() * 10.0f, Frame::Current::max));
         }
         else
         {
@@ -848,15 +1045,12 @@ namespace bitbot
         if (this->Enable__ && this->PowerOn__)
         {
             data.id = this->id_;
-            data.dlc = 3;
-            data.rtr = 0;
-            constexpr uint8_t ack_status = 0x01;
-            constexpr uint8_t ctrl_status = 0x00;
 
-            int16_t cur_tor = this->RuntimeData__.TargetCurrent.load() * this->ConfigData__->MOTOR_DIRECTION * 100.0;
-            data.data[0] = 0x60 | ctrl_status << 2 | ack_status;
-            data.data[1] = cur_tor >> 8;
-            data.data[2] = cur_tor & 0xff;
+            constexpr uint32_t ack_status = 0x01;
+            constexpr uint32_t ctrl_status = 0x00;
+            using Frame = EncosFrame::CurrentCommand;
+            const int16_t cur = EncosSaturateInt16(this->RuntimeData__.TargetCurrent.load() * this->ConfigData__->MOTOR_DIRECTION * 100.0f);
+            Frame::Layout::Pack(data, Frame::header, 0, ctrl_status, ack_status, static_cast<uint16_t>(cur));
         }
         else
         {
@@ -869,15 +1063,12 @@ namespace bitbot
         if (this->Enable__ && this->PowerOn__)
         {
             data.id = this->id_;
-            data.dlc = 3;
-            data.rtr = 0;
-            constexpr uint8_t ack_status = 0x01;
-            constexpr uint8_t ctrl_status = 0x01;
 
-            int16_t cur_tor = this->RuntimeData__.TargetTorque.load() * this->ConfigData__->MOTOR_DIRECTION * 100.0;
-            data.data[0] = 0x60 | ctrl_status << 2 | ack_status;
-            data.data[1] = cur_tor >> 8;
-            data.data[2] = cur_tor & 0xff;
+            constexpr uint32_t ack_status = 0x01;
+            constexpr uint32_t ctrl_status = 0x01;
+            using Frame = EncosFrame::CurrentCommand;
+            const int16_t tor = EncosSaturateInt16(this->RuntimeData__.TargetTorque.load() * this->ConfigData__->MOTOR_DIRECTION * 100.0f);
+            Frame::Layout::Pack(data, Frame::header, 0, ctrl_status, ack_status, static_cast<uint16_t>(tor));
         }
         else
         {
@@ -887,101 +1078,48 @@ namespace bitbot
 
     void EncosJoint::WriteBusSetMotorDisabledControl(CAN_Device_Msg &data)
     {
-
         data.id = this->id_;
-        data.dlc = 3;
-        data.rtr = 0;
-        constexpr uint8_t ack_status = 0x01;
-        constexpr uint8_t ctrl_status = 0x00;
-        constexpr int16_t cur_tor = 0x00;
-        data.data[0] = 0x60 | ctrl_status << 2 | ack_status;
-        data.data[1] = cur_tor >> 8;
-        data.data[2] = cur_tor & 0xff;
+
+        constexpr uint32_t ack_status = 0x01;
+        constexpr uint32_t ctrl_status = 0x00;
+        using Frame = EncosFrame::CurrentCommand;
+        Frame::Layout::Pack(data, Frame::header, 0, ctrl_status, ack_status, 0);
     }
 
     void EncosJoint::WriteBusSetZero(CAN_Device_Msg &data)
     {
         data.id = this->Alternative_ID__;
-        data.rtr = 0;
-        data.dlc = 4;
-        uint16_t motor_id = this->id_;
-        data.data[0] = motor_id >> 8;
-        data.data[1] = motor_id & 0xff;
-        data.data[2] = 0x00;
-        data.data[3] = 0x03;
+        EncosFrame::AlternativeCommand::Layout::Pack(data, static_cast<uint32_t>(this->id_), 0x00, 0x03);
     }
 
     void EncosJoint::WriteBusReadCommMode(CAN_Device_Msg &data)
     {
-        data.rtr = 0;
         data.id = this->Alternative_ID__;
-        data.dlc = 4;
-
-        uint16_t motor_id = this->id_;
-        data.data[0] = motor_id >> 8;
-        data.data[1] = motor_id & 0xff;
-        data.data[2] = 0x00;
-        data.data[3] = 0x81;
+        EncosFrame::AlternativeCommand::Layout::Pack(data, static_cast<uint32_t>(this->id_), 0x00, 0x81);
     }
 
     void EncosJoint::WriteBusRead_CAN_ID(CAN_Device_Msg &data)
     {
-        data.rtr = 0;
         data.id = this->Alternative_ID__;
-        data.dlc = 4;
-
-        data.data[0] = 0xFF;
-        data.data[1] = 0xFF;
-        data.data[2] = 0x00;
-        data.data[3] = 0x82;
+        EncosFrame::AlternativeCommand::Layout::Pack(data, 0xFFFF, 0x00, 0x82);
     }
 
-    void EncosJoint::WriteBusSettingsMotorAcc(CAN_Device_Msg &data)
+    void EncosJoint::WriteBusSettings(CAN_Device_Msg &data, const EncosJointConfigCommand &cmd)
     {
-        data.dlc = 4;
-        data.rtr = 0;
         data.id = this->id_;
 
-        uint16_t acc = this->RuntimeData__.SettingsAcc.load() * 100.0;
-        constexpr uint8_t ack_status = 0x01;
-        data.data[0] = 0xC0 | ack_status;
-        data.data[1] = 0x01;
-        data.data[2] = acc >> 8;
-        data.data[3] = acc & 0xff;
-    }
-
-    void EncosJoint::WriteBusSettingsLinkComp(CAN_Device_Msg &data)
-    {
-        data.dlc = 6;
-        data.rtr = 0;
-        data.id = this->id_;
-
-        uint16_t linkage = this->RuntimeData__.SettingsMagLinkGain.load() * 10000.0;
-        uint16_t speedKI = this->RuntimeData__.SettingsDisturbComp.load() * 10000.0;
-
-        constexpr uint8_t ack_status = 0x01;
-        data.data[0] = 0xC0 | ack_status;
-        data.data[1] = 0x02;
-        data.data[2] = linkage >> 8;
-        data.data[3] = linkage & 0xff;
-        data.data[4] = speedKI >> 8;
-        data.data[5] = speedKI & 0xff;
-    }
-
-    void EncosJoint::WriteBusSettings_FB_KD(CAN_Device_Msg &data)
-    {
-        data.rtr = 0;
-        data.dlc = 6;
-        data.id = this->id_;
-
-        uint16_t fdbKP = this->RuntimeData__.Settings_FB_KP * 10000.0;
-        uint16_t fdbKD = this->RuntimeData__.Settings_FB_KD * 10000.0;
-        constexpr uint8_t ack_status = 0x01;
-        data.data[0] = 0xC0 | ack_status;
-        data.data[1] = 0x03;
-        data.data[2] = fdbKP >> 8;
-        data.data[3] = fdbKP & 0xff;
-        data.data[4] = fdbKD >> 8;
-        data.data[5] = fdbKD & 0xff;
+        constexpr uint32_t ack_status = 0x01;
+        using Frame = EncosFrame::SettingsCommand;
+        if (cmd.code == 0x01)
+        {
+            Frame::Layout4::Pack(data, Frame::header, ack_status, cmd.code,
+                EncosSaturateUInt(cmd.value0 * 100.0f, Frame::Value0::max));
+        }
+        else
+        {
+            Frame::Layout6::Pack(data, Frame::header, ack_status, cmd.code,
+                EncosSaturateUInt(cmd.value0 * 10000.0f, Frame::Value0::max),
+                EncosSaturateUInt(cmd.value1 * 10000.0f, Frame::Value1::max));
+        }
     }
 };
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <sys/time.h>
 #include <string.h>
 #include <getopt.h>
+#include <poll.h>
 
 namespace bitbot
 {
@@ -19,7 +20,8 @@ namespace bitbot
     {
         this->basic_type_ = static_cast<uint32_t>(BasicDeviceType::IMU);
         this->type_ = static_cast<uint32_t>(EncosDeviceType::Yesense_IMU);
-        this->monitor_header_.headers = { "roll", "pitch", "yaw", "acc_x", "acc_y", "acc_z", "gyro_x", "gyro_y", "gyro_z","IMU_temp" };
+        this->monitor_header_.headers = { "roll", "pitch", "yaw", "acc_x", "acc_y", "acc_z", "gyro_x", "gyro_y", "gyro_z","IMU_temp",
+                                          "frames", "dropped_frames", "crc_errors", "sample_interval_us" };
         this->monitor_data_.resize(monitor_header_.headers.size());
         // TODO: get name and speed from xml
         ConfigParser::ParseAttribute2s(this->dev, imu_node.attribute("dev"));
@@ -43,12 +45,12 @@ namespace bitbot
         tcflush(fd, TCIFLUSH);
         tcsetattr(fd, TCSAFLUSH, &newtio);
         // tcgetattr(fd, &oldtio);
-
-        memset(buffer, 0, sizeof(buffer));
     }
 
     YesenseIMU::~YesenseIMU()
     {
+        // the I/O thread reads fd, stop it before closing
+        this->StopAsyncIO();
         close(fd);
     }
 
@@ -94,44 +96,132 @@ namespace bitbot
     }
 
 
+    ImuStateSnapshot YesenseIMU::GetState()
+    {
+        const ImuRuntimeData& runtime = this->imu_data_.runtime;
+        ImuStateSnapshot state;
+        state.roll = runtime.roll.load(std::memory_order_relaxed) * d2r;
+        state.pitch = runtime.pitch.load(std::memory_order_relaxed) * d2r;
+        state.yaw = runtime.yaw.load(std::memory_order_relaxed) * d2r;
+        state.acc_x = runtime.a_x.load(std::memory_order_relaxed);
+        state.acc_y = runtime.a_y.load(std::memory_order_relaxed);
+        state.acc_z = runtime.a_z.load(std::memory_order_relaxed);
+        state.gyro_x = runtime.w_x.load(std::memory_order_relaxed) * d2r;
+        state.gyro_y = runtime.w_y.load(std::memory_order_relaxed) * d2r;
+        state.gyro_z = runtime.w_z.load(std::memory_order_relaxed) * d2r;
+        state.temperature = runtime.IMU_temp.load(std::memory_order_relaxed);
+        return state;
+    }
+
     void YesenseIMU::UpdateRuntimeData()
+    {
+        uint32_t sample[K_MONITOR_SAMPLE_WORDS];
+        this->CaptureMonitorSample(sample);
+        this->UpdateMonitorData(sample);
+    }
+
+    size_t YesenseIMU::MonitorSampleWords() const
+    {
+        return K_MONITOR_SAMPLE_WORDS;
+    }
+
+    void YesenseIMU::CaptureMonitorSample(uint32_t* sample) const
     {
         // his->monitor_header_.headers = { "roll", "pitch", "yaw", "acc_x", "acc_y", "acc_z", "gyro_x", "gyro_y", "gyro_z" };
-        this->monitor_data_[0] = this->imu_data_.runtime.roll.load();
-        this->monitor_data_[1] = this->imu_data_.runtime.pitch.load();
-        this->monitor_data_[2] = this->imu_data_.runtime.yaw.load();
-        this->monitor_data_[3] = this->imu_data_.runtime.a_x.load();
-        this->monitor_data_[4] = this->imu_data_.runtime.a_y.load();
-        this->monitor_data_[5] = this->imu_data_.runtime.a_z.load();
-        this->monitor_data_[6] = this->imu_data_.runtime.w_x.load();
-        this->monitor_data_[7] = this->imu_data_.runtime.w_y.load();
-        this->monitor_data_[8] = this->imu_data_.runtime.w_z.load();
-        this->monitor_data_[9] = this->imu_data_.runtime.IMU_temp.load();
+        const float s[K_IMU_SAMPLE_WORDS] = {
+            this->imu_data_.runtime.roll.load(),
+            this->imu_data_.runtime.pitch.load(),
+            this->imu_data_.runtime.yaw.load(),
+            this->imu_data_.runtime.a_x.load(),
+            this->imu_data_.runtime.a_y.load(),
+            this->imu_data_.runtime.a_z.load(),
+            this->imu_data_.runtime.w_x.load(),
+            this->imu_data_.runtime.w_y.load(),
+            this->imu_data_.runtime.w_z.load(),
+            this->imu_data_.runtime.IMU_temp.load()
+        };
+        memcpy(sample, s, sizeof(s));
+
+        const ImuStreamStatistics& stream = this->imu_data_.stream;
+        sample[K_IMU_SAMPLE_WORDS] = stream.frames.load(std::memory_order_relaxed);
+        sample[K_IMU_SAMPLE_WORDS + 1] = stream.dropped_frames.load(std::memory_order_relaxed);
+        sample[K_IMU_SAMPLE_WORDS + 2] = stream.crc_errors.load(std::memory_order_relaxed);
+        sample[K_IMU_SAMPLE_WORDS + 3] = stream.sample_interval_us.load(std::memory_order_relaxed);
+    }
+
+    void YesenseIMU::UpdateMonitorData(const uint32_t* sample)
+    {
+        float s[K_IMU_SAMPLE_WORDS];
+        memcpy(s, sample, sizeof(s));
+        for (size_t i = 0; i < K_IMU_SAMPLE_WORDS; i++)
+        {
+            this->monitor_data_[i] = s[i];
+        }
+        for (size_t i = K_IMU_SAMPLE_WORDS; i < K_MONITOR_SAMPLE_WORDS; i++)
+        {
+            this->monitor_data_[i] = sample[i];
+        }
     }
 
     void YesenseIMU::ReadOnce() // call this function in the bus loop
     {
-        nread = read(fd, buffer, RX_BUF_LEN);
-        if (nread > 0)
+        if (this->AsyncIOEnabled())
         {
-            // printf("nread = %d\n", nread);
-            if (g_recv_buf_idx + nread >= RX_BUF_LEN * 2)
-            {
-                printf("buffer overflow!\n");
-                nread = RX_BUF_LEN * 2 - g_recv_buf_idx;
-            }
-            memcpy(g_recv_buf + g_recv_buf_idx, buffer, nread);
-            g_recv_buf_idx += nread;
+            if (const YesenseImuSample* sample = this->Mailbox.Acquire())
+                this->UpdateImuData(*sample);
+            return;
         }
 
-        cnt = g_recv_buf_idx;
-        pos = 0;
-        if (cnt < YIS_OUTPUT_MIN_BYTES)
+        if (this->ReadSerial())
         {
+            YesenseImuSample sample;
+            this->DecodeSample(sample);
+            this->UpdateImuData(sample);
+        }
+    }
+
+    bool YesenseIMU::AsyncIOSupported() const
+    {
+        return true;
+    }
+
+    void YesenseIMU::PollOnce() // call this function in the device I/O thread
+    {
+        struct pollfd pfd = { this->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, K_POLL_TIMEOUT_MS) <= 0)
             return;
+
+        if (this->ReadSerial())
+        {
+            this->DecodeSample(this->Mailbox.WriteBuffer());
+            this->Mailbox.Publish();
+        }
+    }
+
+    bool YesenseIMU::ReadSerial()
+    {
+        // drain what the driver holds, the port is never flushed and a partial frame stays in g_recv_buf for the next call
+        bool decoded = false;
+        while (true)
+        {
+            const int space = RX_BUF_LEN * 2 - g_recv_buf_idx;
+            nread = read(fd, g_recv_buf + g_recv_buf_idx, space);
+            if (nread <= 0)
+                break;
+            g_recv_buf_idx += nread;
+            decoded = this->ParseFrames() || decoded;
+            if (nread < space)
+                break;
         }
+        return decoded;
+    }
 
-        while (cnt > (unsigned int)0)
+    bool YesenseIMU::ParseFrames()
+    {
+        bool decoded = false;
+        cnt = g_recv_buf_idx;
+        pos = 0;
+        while (cnt >= YIS_OUTPUT_MIN_BYTES)
         {
             int ret = analysis_data(g_recv_buf + pos, cnt, &g_output_info);
             if (analysis_done == ret) /*未查找到帧头*/
@@ -139,41 +229,87 @@ namespace bitbot
                 pos++;
                 cnt--;
             }
-            else if (data_len_err == ret)
+            else if (data_len_err == ret) /*帧不完整，等待后续数据*/
             {
                 break;
             }
-            else if (crc_err == ret || analysis_ok == ret) /*删除已解析完的完整一帧*/
+            else if (crc_err == ret)
+            {
+                // the header may be a false match inside a payload, resync from the next byte
+                this->imu_data_.stream.crc_errors.store(this->imu_data_.stream.crc_errors.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                pos++;
+                cnt--;
+            }
+            else if (analysis_ok == ret) /*删除已解析完的完整一帧*/
             {
                 output_data_header_t* header = (output_data_header_t*)(g_recv_buf + pos);
                 unsigned int frame_len = header->len + YIS_OUTPUT_MIN_BYTES;
+                this->CountFrame(header->tid);
                 cnt -= frame_len;
                 pos += frame_len;
-                // memcpy(g_recv_buf, g_recv_buf + pos, cnt);
-
-                if (analysis_ok == ret)
-                {
-                    this->UpdateImuDataFromBus();
-                }
+                // g_output_info always holds the latest decoded frame
+                decoded = true;
+            }
+            else
+            {
+                break;
             }
         }
 
-        memcpy(g_recv_buf, g_recv_buf + pos, cnt);
+        memmove(g_recv_buf, g_recv_buf + pos, cnt);
         g_recv_buf_idx = cnt;
-        tcflush(fd, TCIFLUSH);
+        return decoded;
+    }
+
+    void YesenseIMU::CountFrame(unsigned short tid)
+    {
+        // only the reading thread writes the statistics
+        ImuStreamStatistics& stream = this->imu_data_.stream;
+        stream.frames.store(stream.frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (this->LastTid != 0)
+        {
+            const unsigned int expected = this->LastTid % K_TID_MAX + 1;
+            const unsigned int missed = (tid + K_TID_MAX - expected) % K_TID_MAX;
+            // a large jump backwards is a repeated or reordered frame, not a gap
+            if (missed > 0 && missed < K_TID_MAX / 2)
+                stream.dropped_frames.store(stream.dropped_frames.load(std::memory_order_relaxed) + missed, std::memory_order_relaxed);
+        }
+        this->LastTid = tid;
+
+        const unsigned int timestamp = g_output_info.sample_timestamp;
+        if (timestamp != 0 && this->LastSampleTimestamp != 0)
+            stream.sample_interval_us.store(timestamp - this->LastSampleTimestamp, std::memory_order_relaxed);
+        this->LastSampleTimestamp = timestamp;
+    }
+
+    void YesenseIMU::DecodeSample(YesenseImuSample& sample) const
+    {
+        sample.a_x = g_output_info.accel.x;
+        sample.a_y = g_output_info.accel.y;
+        sample.a_z = g_output_info.accel.z;
+        sample.w_x = g_output_info.angle_rate.x;
+        sample.w_y = g_output_info.angle_rate.y;
+        sample.w_z = g_output_info.angle_rate.z;
+        sample.roll = g_output_info.attitude.roll;
+        sample.pitch = g_output_info.attitude.pitch;
+        sample.yaw = g_output_info.attitude.yaw;
+        sample.IMU_temp = g_output_info.sensor_temp;
     }
 
-    void YesenseIMU::UpdateImuDataFromBus()
+    void YesenseIMU::UpdateImuData(const YesenseImuSample& sample)
     {
-        this->imu_data_.runtime.a_x = g_output_info.accel.x;
-        this->imu_data_.runtime.a_y = g_output_info.accel.y;
-        this->imu_data_.runtime.a_z = g_output_info.accel.z;
-        this->imu_data_.runtime.w_x = g_output_info.angle_rate.x;
-        this->imu_data_.runtime.w_y = g_output_info.angle_rate.y;
-        this->imu_data_.runtime.w_z = g_output_info.angle_rate.z;
-        this->imu_data_.runtime.roll = g_output_info.attitude.roll;
-        this->imu_data_.runtime.pitch = g_output_info.attitude.pitch;
-        this->imu_data_.runtime.yaw = g_output_info.attitude.yaw;
-        this->imu_data_.runtime.IMU_temp = g_output_info.sensor_temp;
+        // other threads read a consistent copy from the bus snapshot, no fence is needed per field
+        ImuRuntimeData& runtime = this->imu_data_.runtime;
+        runtime.a_x.store(sample.a_x, std::memory_order_relaxed);
+        runtime.a_y.store(sample.a_y, std::memory_order_relaxed);
+        runtime.a_z.store(sample.a_z, std::memory_order_relaxed);
+        runtime.w_x.store(sample.w_x, std::memory_order_relaxed);
+        runtime.w_y.store(sample.w_y, std::memory_order_relaxed);
+        runtime.w_z.store(sample.w_z, std::memory_order_relaxed);
+        runtime.roll.store(sample.roll, std::memory_order_relaxed);
+        runtime.pitch.store(sample.pitch, std::memory_order_relaxed);
+        runtime.yaw.store(sample.yaw, std::memory_order_relaxed);
+        runtime.IMU_temp.store(sample.IMU_temp, std::memory_order_relaxed);
     }
 };
\ No newline at end of file
@@ -0,0 +1,331 @@
+/**
+ * @file Encos_bench.cpp
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos bus loop microbenchmarks
+ * @details 总线循环热点路径的微基准测试，每一项都与原先的实现对比。结果只用于比较，不作为测试的判定条件。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include "device/Encos_codec.hpp"
+#include "algorithm"
+#include "chrono"
+#include "cstdio"
+#include "map"
+#include "random"
+#include "vector"
+
+using namespace bitbot;
+
+namespace
+{
+    constexpr size_t K_JOINTS = 128;
+    constexpr int K_ITERATIONS = 20000;
+    std::mt19937 rng(20250101);
+
+    /**
+     * @brief 运行一项基准测试并输出每次调用的平均耗时
+     *
+     * @param name 测试名称
+     * @param fn 被测函数，调用K_ITERATIONS次
+     */
+    template <typename Fn>
+    void Bench(const char* name, Fn&& fn)
+    {
+        fn(); // warm up caches and branch predictors
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < K_ITERATIONS; i++)
+        {
+            fn();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count() / K_ITERATIONS;
+        std::printf("%-40s %10.1f ns/call\n", name, ns);
+    }
+
+    template <typename T>
+    void DoNotOptimize(const T& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    void BenchCodec()
+    {
+        using F = EncosFrame::MotionCommand;
+        std::vector<CAN_Device_Msg> frames(K_JOINTS);
+        std::vector<uint32_t> kp(K_JOINTS), kd(K_JOINTS), pos(K_JOINTS), spd(K_JOINTS), tor(K_JOINTS);
+        for (size_t i = 0; i < K_JOINTS; i++)
+        {
+            kp[i] = rng() & F::Kp::max;
+            kd[i] = rng() & F::Kd::max;
+            pos[i] = rng() & F::Position::max;
+            spd[i] = rng() & F::Velocity::max;
+            tor[i] = rng() & F::Torque::max;
+        }
+
+        std::printf("motion command pack, %zu joints\n", K_JOINTS);
+        Bench("  legacy shift code", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    uint8_t* d = frames[i].data;
+                    d[0] = 0x00 | (kp[i] >> 7);
+                    d[1] = ((kp[i] & 0x7F) << 1) | ((kd[i] & 0x100) >> 8);
+                    d[2] = kd[i] & 0xFF;
+                    d[3] = pos[i] >> 8;
+                    d[4] = pos[i] & 0xFF;
+                    d[5] = spd[i] >> 4;
+                    d[6] = (spd[i] & 0x0F) << 4 | (tor[i] >> 8);
+                    d[7] = tor[i] & 0xff;
+                    frames[i].dlc = 8;
+                    frames[i].rtr = 0;
+                }
+                DoNotOptimize(frames.data()); });
+        Bench("  EncosFrameLayout::Pack", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    F::Layout::Pack(frames[i], F::header, kp[i], kd[i], pos[i], spd[i], tor[i]);
+                }
+                DoNotOptimize(frames.data()); });
+
+        std::printf("motion reply unpack, %zu joints\n", K_JOINTS);
+        using R = EncosFrame::ReplyType1;
+        std::vector<uint32_t> out(K_JOINTS * 3);
+        Bench("  legacy shift code", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    const uint8_t* d = frames[i].data;
+                    out[i * 3] = d[1] << 8 | d[2];
+                    out[i * 3 + 1] = d[3] << 4 | (d[4] & 0xF0) >> 4;
+                    out[i * 3 + 2] = (d[4] & 0x0F) << 8 | d[5];
+                }
+                DoNotOptimize(out.data()); });
+        Bench("  EncosBitField::Get", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    const uint64_t word = R::Layout::Load(frames[i]);
+                    out[i * 3] = R::Position::Get(word);
+                    out[i * 3 + 1] = R::Velocity::Get(word);
+                    out[i * 3 + 2] = R::Current::Get(word);
+                }
+                DoNotOptimize(out.data()); });
+    }
+
+    // EncosJoint::float_to_uint and EncosJoint::uint_to_float used by WriteBus and ReadBus before EncosLinearScale
+    uint32_t LegacyFloatToUint(float x, float x_min, float x_max, int bits)
+    {
+        float span = x_max - x_min;
+        float offset = x_min;
+        return (uint32_t)((x - offset) * ((float)((1 << bits) - 1)) / span);
+    }
+
+    float LegacyUintToFloat(uint32_t x_int, float x_min, float x_max, int bits)
+    {
+        float span = x_max - x_min;
+        float offset = x_min;
+        return ((float)x_int) * span / ((float)((1 << bits) - 1)) + offset;
+    }
+
+    void BenchScale()
+    {
+        // motion command fields kp, kd, position, velocity, torque and reply fields position, velocity, current
+        struct Field
+        {
+            float min;
+            float max;
+            int bits;
+        };
+        constexpr Field command[5] = { { 0.0f, 500.0f, 12 }, { 0.0f, 5.0f, 9 }, { -12.5f, 12.5f, 16 }, { -18.0f, 18.0f, 12 }, { -30.0f, 30.0f, 12 } };
+        constexpr Field reply[3] = { { -12.5f, 12.5f, 16 }, { -18.0f, 18.0f, 12 }, { -30.0f, 30.0f, 12 } };
+        EncosLinearScale command_scale[5], reply_scale[3];
+        for (size_t f = 0; f < 5; f++)
+            command_scale[f] = EncosLinearScale::Make(command[f].min, command[f].max, command[f].bits);
+        for (size_t f = 0; f < 3; f++)
+            reply_scale[f] = EncosLinearScale::Make(reply[f].min, reply[f].max, reply[f].bits);
+
+        std::vector<float> x(K_JOINTS * 5), y(K_JOINTS * 3);
+        std::vector<uint32_t> raw(K_JOINTS * 3), out(K_JOINTS * 5);
+        for (size_t i = 0; i < K_JOINTS; i++)
+        {
+            for (size_t f = 0; f < 5; f++)
+                x[i * 5 + f] = std::uniform_real_distribution<float>(command[f].min, command[f].max)(rng);
+            for (size_t f = 0; f < 3; f++)
+                raw[i * 3 + f] = rng() & ((1u << reply[f].bits) - 1);
+        }
+
+        std::printf("motion command quantization, legacy vs scale, %zu joints\n", K_JOINTS);
+        Bench("  legacy float_to_uint", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    for (size_t f = 0; f < 5; f++)
+                        out[i * 5 + f] = LegacyFloatToUint(x[i * 5 + f], command[f].min, command[f].max, command[f].bits);
+                }
+                DoNotOptimize(out.data()); });
+        Bench("  EncosLinearScale::Encode", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    for (size_t f = 0; f < 5; f++)
+                        out[i * 5 + f] = command_scale[f].Encode(x[i * 5 + f]);
+                }
+                DoNotOptimize(out.data()); });
+
+        std::printf("motion reply dequantization, legacy vs scale, %zu joints\n", K_JOINTS);
+        Bench("  legacy uint_to_float", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    for (size_t f = 0; f < 3; f++)
+                        y[i * 3 + f] = LegacyUintToFloat(raw[i * 3 + f], reply[f].min, reply[f].max, reply[f].bits);
+                }
+                DoNotOptimize(y.data()); });
+        Bench("  EncosLinearScale::Decode", [&]
+            {
+                for (size_t i = 0; i < K_JOINTS; i++)
+                {
+                    for (size_t f = 0; f < 3; f++)
+                        y[i * 3 + f] = reply_scale[f].Decode(raw[i * 3 + f]);
+                }
+                DoNotOptimize(y.data()); });
+    }
+
+    void BenchQuantize()
+    {
+        constexpr size_t n = K_JOINTS * 5; // kp, kd, position, velocity and torque of every joint
+        std::vector<EncosLinearScale> scales(n);
+        std::vector<float> x(n), mul(n), min(n);
+        std::vector<uint32_t> out(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            scales[i] = EncosLinearScale::Make(-12.5f, 12.5f, 16);
+            mul[i] = scales[i].to_int;
+            min[i] = scales[i].min;
+            x[i] = std::uniform_real_distribution<float>(-15.0f, 15.0f)(rng);
+        }
+
+        std::printf("motion command quantization, %zu joints\n", K_JOINTS);
+        Bench("  EncosLinearScale::Encode", [&]
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    out[i] = scales[i].Encode(x[i]);
+                }
+                DoNotOptimize(out.data()); });
+        Bench("  EncosQuantizeBatch", [&]
+            {
+                EncosQuantizeBatch(n, x.data(), mul.data(), min.data(), 65535.0f, out.data());
+                DoNotOptimize(out.data()); });
+    }
+
+    // stand-in for Encos_CANBusDevice, the dispatch cost includes the virtual call
+    struct BenchDevice
+    {
+        virtual ~BenchDevice() = default;
+        virtual void ReadBus(const CAN_Device_Msg& data)
+        {
+            this->sum += data.data[0];
+        }
+        uint32_t sum = 0;
+    };
+
+    // same layout as CAN_RouteSpan in bus/Encos_bus.h
+    struct RouteSpan
+    {
+        uint16_t offset = 0;
+        uint16_t count = 0;
+    };
+
+    void BenchDispatch()
+    {
+        constexpr size_t slots = 6;
+        constexpr size_t slave_count = 20;
+        constexpr size_t joints = slave_count * slots;
+        constexpr size_t id_space = 0x800;
+
+        std::vector<BenchDevice> devices(joints);
+        std::vector<EtherCAT_Msg> inputs(slave_count);
+        std::vector<std::vector<BenchDevice*>> by_slave(slave_count);
+        for (size_t i = 0; i < joints; i++)
+        {
+            const size_t slave = i / slots;
+            const uint32_t id = static_cast<uint32_t>(i + 1); // unique over all slaves, the old map did not tell slaves apart
+            by_slave[slave].push_back(&devices[i]);
+            CAN_Device_Msg& frame = inputs[slave].device[inputs[slave].device_number++];
+            frame.id = id;
+            frame.dlc = 8;
+            frame.data[0] = static_cast<uint8_t>(i);
+        }
+
+        // the lookup ReadBus used before the route table, one map keyed by CAN id
+        std::map<size_t, std::vector<BenchDevice*>> by_id;
+        for (size_t s = 0; s < slave_count; s++)
+        {
+            for (size_t j = 0; j < inputs[s].device_number; j++)
+            {
+                by_id[inputs[s].device[j].id].push_back(by_slave[s][j]);
+            }
+        }
+
+        // the route table built by EncosBus::BuildRouteTable
+        std::vector<BenchDevice*> route;
+        std::vector<RouteSpan> spans(slave_count * id_space);
+        for (size_t s = 0; s < slave_count; s++)
+        {
+            for (size_t j = 0; j < inputs[s].device_number; j++)
+            {
+                RouteSpan& span = spans[s * id_space + inputs[s].device[j].id];
+                span.offset = static_cast<uint16_t>(route.size());
+                span.count = 1;
+                route.push_back(by_slave[s][j]);
+            }
+        }
+
+        std::printf("CAN reply dispatch, %zu joints on %zu slaves\n", joints, slave_count);
+        Bench("  std::map by CAN id", [&]
+            {
+                for (size_t s = 0; s < slave_count; s++)
+                {
+                    const EtherCAT_Msg& msg = inputs[s];
+                    for (size_t j = 0; j < msg.device_number; j++)
+                    {
+                        for (auto dev : by_id[msg.device[j].id])
+                        {
+                            dev->ReadBus(msg.device[j]);
+                        }
+                    }
+                } });
+        Bench("  flat route table", [&]
+            {
+                for (size_t s = 0; s < slave_count; s++)
+                {
+                    const EtherCAT_Msg& msg = inputs[s];
+                    const RouteSpan* slave_spans = spans.data() + s * id_space;
+                    const size_t device_number = std::min<size_t>(msg.device_number, slots);
+                    for (size_t j = 0; j < device_number; j++)
+                    {
+                        const uint32_t id = msg.device[j].id;
+                        if (id >= id_space) [[unlikely]]
+                            continue;
+                        const RouteSpan span = slave_spans[id];
+                        BenchDevice* const* devs = route.data() + span.offset;
+                        for (size_t k = 0; k < span.count; k++)
+                        {
+                            devs[k]->ReadBus(msg.device[j]);
+                        }
+                    }
+                } });
+    }
+}
+
+int main()
+{
+    BenchCodec();
+    BenchScale();
+    BenchQuantize();
+    BenchDispatch();
+    return 0;
+}
@@ -0,0 +1,354 @@
+/**
+ * @file Encos_codec_test.cpp
+ * @author zishun zhou (zhouzishun@mail.zzshub.cn)
+ * @brief Bitbot Encos CAN frame codec test
+ * @details 将EncosFrame中每种帧格式的编解码结果与原先手写的移位代码逐位比较，并固定EncosLinearScale的舍入和饱和行为。
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include "device/Encos_codec.hpp"
+#include "cmath"
+#include "cstdio"
+#include "cstring"
+#include "limits"
+#include "random"
+#include "vector"
+
+using namespace bitbot;
+
+namespace
+{
+    int failures = 0;
+
+#define EXPECT(cond)                                                                 \
+    do                                                                               \
+    {                                                                                \
+        if (!(cond))                                                                 \
+        {                                                                            \
+            std::printf("%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond);    \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+    constexpr int K_ROUNDS = 10000;
+    std::mt19937 rng(20250101);
+
+    uint32_t Random(uint32_t max)
+    {
+        return std::uniform_int_distribution<uint32_t>(0, max)(rng);
+    }
+
+    bool SameFrame(const CAN_Device_Msg& a, const uint8_t (&data)[8], uint8_t dlc)
+    {
+        return a.dlc == dlc && std::memcmp(a.data, data, dlc) == 0;
+    }
+
+    // reference packers, the shift code EncosJoint used before the codec was introduced
+
+    void LegacyMotion(uint8_t (&d)[8], uint32_t kp, uint32_t kd, uint32_t pos, uint32_t spd, uint32_t tor)
+    {
+        d[0] = 0x00 | (kp >> 7);
+        d[1] = ((kp & 0x7F) << 1) | ((kd & 0x100) >> 8);
+        d[2] = kd & 0xFF;
+        d[3] = pos >> 8;
+        d[4] = pos & 0xFF;
+        d[5] = spd >> 4;
+        d[6] = (spd & 0x0F) << 4 | (tor >> 8);
+        d[7] = tor & 0xff;
+    }
+
+    void LegacyPosition(uint8_t (&d)[8], uint32_t value, uint32_t spd, uint32_t cur, uint32_t ack)
+    {
+        const uint8_t b[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+        d[0] = 0x20 | (b[3] >> 3);
+        d[1] = (b[3] << 5) | (b[2] >> 3);
+        d[2] = (b[2] << 5) | (b[1] >> 3);
+        d[3] = (b[1] << 5) | (b[0] >> 3);
+        d[4] = (b[0] << 5) | (spd >> 10);
+        d[5] = (spd & 0x3FC) >> 2;
+        d[6] = (spd & 0x03) << 6 | (cur >> 6);
+        d[7] = (cur & 0x3F) << 2 | ack;
+    }
+
+    void LegacyVelocity(uint8_t (&d)[8], uint32_t value, uint32_t cur, uint32_t ack)
+    {
+        d[0] = 0x40 | ack;
+        d[1] = value >> 24;
+        d[2] = value >> 16;
+        d[3] = value >> 8;
+        d[4] = value;
+        d[5] = cur >> 8;
+        d[6] = cur & 0xff;
+    }
+
+    void LegacyCurrent(uint8_t (&d)[8], uint32_t ctrl, uint32_t ack, int16_t value)
+    {
+        d[0] = 0x60 | ctrl << 2 | ack;
+        d[1] = static_cast<uint16_t>(value) >> 8;
+        d[2] = static_cast<uint16_t>(value) & 0xff;
+    }
+
+    void LegacySettings(uint8_t (&d)[8], uint32_t ack, uint32_t code, uint32_t v0, uint32_t v1)
+    {
+        d[0] = 0xC0 | ack;
+        d[1] = code;
+        d[2] = v0 >> 8;
+        d[3] = v0 & 0xff;
+        d[4] = v1 >> 8;
+        d[5] = v1 & 0xff;
+    }
+
+    void LegacyAlternative(uint8_t (&d)[8], uint32_t motor_id, uint32_t code)
+    {
+        d[0] = motor_id >> 8;
+        d[1] = motor_id & 0xff;
+        d[2] = 0x00;
+        d[3] = code;
+    }
+
+    // the truncating quantization EncosJoint used before EncosLinearScale
+    uint32_t LegacyFloatToUint(float x, float x_min, float x_max, int bits)
+    {
+        return (uint32_t)((x - x_min) * ((float)((1 << bits) - 1)) / (x_max - x_min));
+    }
+
+    void TestCommands()
+    {
+        for (int round = 0; round < K_ROUNDS; round++)
+        {
+            CAN_Device_Msg msg{};
+            uint8_t ref[8] = { 0 };
+
+            {
+                using F = EncosFrame::MotionCommand;
+                const uint32_t kp = Random(F::Kp::max), kd = Random(F::Kd::max), pos = Random(F::Position::max), spd = Random(F::Velocity::max), tor = Random(F::Torque::max);
+                F::Layout::Pack(msg, F::header, kp, kd, pos, spd, tor);
+                LegacyMotion(ref, kp, kd, pos, spd, tor);
+                EXPECT(SameFrame(msg, ref, 8));
+                const uint64_t word = F::Layout::Load(msg);
+                EXPECT(F::Kp::Get(word) == kp && F::Kd::Get(word) == kd && F::Position::Get(word) == pos && F::Velocity::Get(word) == spd && F::Torque::Get(word) == tor);
+            }
+
+            {
+                using F = EncosFrame::PositionCommand;
+                const uint32_t value = Random(UINT32_MAX), spd = Random(F::Velocity::max), cur = Random(F::Current::max), ack = Random(F::AckType::max);
+                F::Layout::Pack(msg, F::header, value, spd, cur, ack);
+                LegacyPosition(ref, value, spd, cur, ack);
+                EXPECT(SameFrame(msg, ref, 8));
+                const uint64_t word = F::Layout::Load(msg);
+                EXPECT(F::Position::Get(word) == value && F::Velocity::Get(word) == spd && F::Current::Get(word) == cur && F::AckType::Get(word) == ack);
+            }
+
+            {
+                using F = EncosFrame::VelocityCommand;
+                const uint32_t value = Random(UINT32_MAX), cur = Random(F::Current::max), ack = Random(F::AckType::max);
+                F::Layout::Pack(msg, F::header, 0, ack, value, cur);
+                LegacyVelocity(ref, value, cur, ack);
+                EXPECT(SameFrame(msg, ref, 7));
+                const uint64_t word = F::Layout::Load(msg);
+                EXPECT(F::Velocity::Get(word) == value && F::Current::Get(word) == cur && F::AckType::Get(word) == ack);
+            }
+
+            {
+                using F = EncosFrame::CurrentCommand;
+                const int16_t value = static_cast<int16_t>(Random(UINT16_MAX));
+                const uint32_t ctrl = Random(1), ack = Random(F::AckType::max);
+                F::Layout::Pack(msg, F::header, 0, ctrl, ack, static_cast<uint16_t>(value));
+                LegacyCurrent(ref, ctrl, ack, value);
+                EXPECT(SameFrame(msg, ref, 3));
+                const uint64_t word = F::Layout::Load(msg);
+                EXPECT(static_cast<int16_t>(F::Value::Get(word)) == value && F::CtrlStatus::Get(word) == ctrl);
+            }
+
+            {
+                using F = EncosFrame::SettingsCommand;
+                const uint32_t ack = Random(F::AckType::max), code = Random(F::Code::max), v0 = Random(F::Value0::max), v1 = Random(F::Value1::max);
+                LegacySettings(ref, ack, code, v0, v1);
+                F::Layout4::Pack(msg, F::header, ack, code, v0);
+                EXPECT(SameFrame(msg, ref, 4));
+                F::Layout6::Pack(msg, F::header, ack, code, v0, v1);
+                EXPECT(SameFrame(msg, ref, 6));
+                const uint64_t word = F::Layout6::Load(msg);
+                EXPECT(F::Code::Get(word) == code && F::Value0::Get(word) == v0 && F::Value1::Get(word) == v1);
+            }
+
+            {
+                using F = EncosFrame::AlternativeCommand;
+                const uint32_t motor_id = Random(F::MotorID::max), code = Random(F::Code::max);
+                F::Layout::Pack(msg, motor_id, 0x00, code);
+                LegacyAlternative(ref, motor_id, code);
+                EXPECT(SameFrame(msg, ref, 4));
+            }
+        }
+
+        // values wider than the field are truncated and never leak into the neighbouring fields
+        CAN_Device_Msg msg{};
+        using F = EncosFrame::MotionCommand;
+        F::Layout::Pack(msg, F::header, 0xFFFFFFFF, 0, 0, 0, 0);
+        const uint64_t word = F::Layout::Load(msg);
+        EXPECT(F::Kp::Get(word) == F::Kp::max && F::Kd::Get(word) == 0 && EncosFrame::Header::Get(word) == F::header);
+    }
+
+    void TestReplies()
+    {
+        for (int round = 0; round < K_ROUNDS; round++)
+        {
+            CAN_Device_Msg msg{};
+            for (auto& byte : msg.data)
+            {
+                byte = static_cast<uint8_t>(Random(0xFF));
+            }
+            const uint8_t* d = msg.data;
+
+            {
+                using F = EncosFrame::ReplyType1;
+                const uint64_t word = F::Layout::Load(msg);
+                EXPECT(EncosFrame::ReplyHeader::AckType::Get(word) == uint32_t(d[0] >> 5));
+                EXPECT(EncosFrame::ReplyHeader::ErrorCode::Get(word) == uint32_t(d[0] & 0x1F));
+                EXPECT(F::Position::Get(word) == uint32_t(d[1] << 8 | d[2]));
+                EXPECT(F::Velocity::Get(word) == uint32_t(d[3] << 4 | (d[4] & 0xF0) >> 4));
+                EXPECT(F::Current::Get(word) == uint32_t((d[4] & 0x0F) << 8 | d[5]));
+                EXPECT(F::MotorTemperature::Get(word) == d[6] && F::DriverTemperature::Get(word) == d[7]);
+                EXPECT(EncosFrame::DecodeTemperature(d[6]) == static_cast<float>(d[6] - 50) / 2.0f);
+            }
+
+            {
+                using F = EncosFrame::ReplyType2;
+                const uint64_t word = F::Layout::Load(msg);
+                EXPECT(F::Value::Get(word) == (uint32_t(d[1]) << 24 | uint32_t(d[2]) << 16 | uint32_t(d[3]) << 8 | d[4]));
+                EXPECT(static_cast<int16_t>(F::Current::Get(word)) == static_cast<int16_t>(d[5] << 8 | d[6]));
+                EXPECT(F::MotorTemperature::Get(word) == d[7]);
+            }
+
+            {
+                using F = EncosFrame::ReplyType4;
+                const uint64_t word = F::Layout::Load(msg);
+                EXPECT(F::Code::Get(word) == d[1] && F::Result::Get(word) == d[2]);
+            }
+        }
+    }
+
+    void TestLinearScale()
+    {
+        constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        const EncosLinearScale pos = EncosLinearScale::Make(-12.5f, 12.5f, 16);
+        const EncosLinearScale kp = EncosLinearScale::Make(0.0f, 500.0f, 12);
+        const float lsb = 25.0f / 65535.0f;
+
+        // saturation
+        EXPECT(pos.Encode(-12.5f) == 0);
+        EXPECT(pos.Encode(12.5f) == 65535);
+        EXPECT(pos.Encode(-100.0f) == 0);
+        EXPECT(pos.Encode(100.0f) == 65535);
+        EXPECT(pos.Encode(nan) == 0);
+        EXPECT(pos.Encode(inf) == 65535);
+        EXPECT(pos.Encode(-inf) == 0);
+        EXPECT(kp.Encode(-1.0f) == 0);
+        EXPECT(kp.Encode(1e9f) == 4095);
+
+        // rounds to nearest, the legacy conversion truncated
+        EXPECT(pos.Encode(-12.5f + 0.6f * lsb) == 1);
+        EXPECT(LegacyFloatToUint(-12.5f + 0.6f * lsb, -12.5f, 12.5f, 16) == 0);
+        EXPECT(pos.Encode(-12.5f + 0.4f * lsb) == 0);
+
+        // the legacy and the new result never differ by more than one step inside the range
+        for (int round = 0; round < K_ROUNDS; round++)
+        {
+            const float x = std::uniform_real_distribution<float>(-12.5f, 12.5f)(rng);
+            const int64_t diff = int64_t(pos.Encode(x)) - int64_t(LegacyFloatToUint(x, -12.5f, 12.5f, 16));
+            EXPECT(diff == 0 || diff == 1);
+        }
+
+        // every integer survives a decode/encode round trip
+        EXPECT(pos.Decode(0) == -12.5f);
+        EXPECT(std::fabs(pos.Decode(65535) - 12.5f) < 1e-5f);
+        for (uint32_t i = 0; i <= 65535; i++)
+        {
+            EXPECT(pos.Encode(pos.Decode(i)) == i);
+        }
+        for (uint32_t i = 0; i <= 4095; i++)
+        {
+            EXPECT(kp.Encode(kp.Decode(i)) == i);
+        }
+
+        EXPECT(EncosSaturateUInt(nan, 1000) == 0);
+        EXPECT(EncosSaturateUInt(-3.0f, 1000) == 0);
+        EXPECT(EncosSaturateUInt(2.5f, 1000) == 3);
+        EXPECT(EncosSaturateUInt(2.4f, 1000) == 2);
+        EXPECT(EncosSaturateUInt(1e6f, 1000) == 1000);
+
+        EXPECT(EncosSaturateInt16(nan) == 0);
+        EXPECT(EncosSaturateInt16(1e6f) == 32767);
+        EXPECT(EncosSaturateInt16(-1e6f) == -32768);
+        EXPECT(EncosSaturateInt16(-2.5f) == -3);
+        EXPECT(EncosSaturateInt16(12.4f) == 12);
+    }
+
+    void TestQuantizeBatch()
+    {
+        constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        constexpr size_t bits[] = { 9, 12, 16 };
+
+        for (size_t b : bits)
+        {
+            // one scale per element, like the joints of a robot with different motors
+            constexpr size_t n = 1024;
+            std::vector<EncosLinearScale> scales(n);
+            std::vector<float> x(n), mul(n), min(n);
+            std::vector<uint32_t> out(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                const float lo = std::uniform_real_distribution<float>(-100.0f, 0.0f)(rng);
+                const float hi = lo + std::uniform_real_distribution<float>(0.1f, 200.0f)(rng);
+                scales[i] = EncosLinearScale::Make(lo, hi, b);
+                mul[i] = scales[i].to_int;
+                min[i] = scales[i].min;
+                const float span = hi - lo;
+                const float step = span / static_cast<float>(scales[i].max);
+                switch (i % 8)
+                {
+                case 0:
+                    x[i] = nan;
+                    break;
+                case 1:
+                    x[i] = (i & 8) ? inf : -inf;
+                    break;
+                case 2:
+                    x[i] = (i & 8) ? lo : hi;
+                    break;
+                case 3: // exactly between two steps, the rounding edge
+                    x[i] = lo + (static_cast<float>(Random(scales[i].max - 1)) + 0.5f) * step;
+                    break;
+                default:
+                    x[i] = std::uniform_real_distribution<float>(lo - span, hi + span)(rng);
+                    break;
+                }
+            }
+
+            EncosQuantizeBatch(n, x.data(), mul.data(), min.data(), static_cast<float>(scales[0].max), out.data());
+            for (size_t i = 0; i < n; i++)
+            {
+                EXPECT(out[i] == scales[i].Encode(x[i]));
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestCommands();
+    TestReplies();
+    TestLinearScale();
+    TestQuantizeBatch();
+
+    if (failures != 0)
+    {
+        std::printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+    std::printf("all codec checks passed.\n");
+    return 0;
+}